@@ -0,0 +1,104 @@
+#pragma once
+
+// Heap allocation tracking for hook bodies, built with `xmake f --alloc_tracking=y`.
+// Hooks run on the game's threads every frame and should never allocate. With tracking on,
+// every allocation made while a hook body is running is counted against that hook, and the
+// first call that allocates is logged. With tracking off, HOOK_ALLOC_SCOPE expands to nothing.
+#ifdef HOOK_ALLOC_TRACKING
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <spdlog/spdlog.h>
+
+namespace AllocTracking
+{
+    struct Counter
+    {
+        const char* name = nullptr;
+        std::atomic<std::uint64_t> calls = 0;
+        std::atomic<std::uint64_t> allocations = 0;
+        std::atomic<bool> reported = false;
+    };
+
+    // Fixed storage so registering a hook never allocates
+    inline Counter Counters[32];
+    inline std::atomic<std::size_t> CounterCount = 0;
+    inline thread_local Counter* Current = nullptr;
+
+    inline Counter& Register(const char* name)
+    {
+        auto index = CounterCount.fetch_add(1);
+        if (index >= std::size(Counters))
+            index = std::size(Counters) - 1;
+        Counters[index].name = name;
+        return Counters[index];
+    }
+
+    // Attributes allocations on this thread to counter until it goes out of scope
+    class Scope
+    {
+    public:
+        explicit Scope(Counter& counter) : counter(counter), previous(Current), before(counter.allocations.load(std::memory_order_relaxed))
+        {
+            counter.calls.fetch_add(1, std::memory_order_relaxed);
+            Current = &counter;
+        }
+
+        ~Scope()
+        {
+            Current = previous;
+
+            auto allocated = counter.allocations.load(std::memory_order_relaxed) - before;
+            if (allocated && !counter.reported.exchange(true))
+                spdlog::warn("Alloc Tracking: {}: Hook allocated {} time(s) in one call.", counter.name, allocated);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Counter& counter;
+        Counter* previous;
+        std::uint64_t before;
+    };
+
+    inline void Report()
+    {
+        auto count = std::min(CounterCount.load(), std::size(Counters));
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& counter = Counters[i];
+            spdlog::info("Alloc Tracking: {}: {} calls, {} allocations.", counter.name, counter.calls.load(), counter.allocations.load());
+        }
+    }
+
+    inline void* Allocate(std::size_t size)
+    {
+        if (auto counter = Current)
+            counter->allocations.fetch_add(1, std::memory_order_relaxed);
+        if (auto memory = std::malloc(size ? size : 1))
+            return memory;
+        throw std::bad_alloc();
+    }
+}
+
+// Replaces the global allocation functions, so this header must only be included by one translation unit
+void* operator new(std::size_t size) { return AllocTracking::Allocate(size); }
+void* operator new[](std::size_t size) { return AllocTracking::Allocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+#define HOOK_ALLOC_SCOPE(name) \
+    static AllocTracking::Counter& hookAllocCounter = AllocTracking::Register(name); \
+    AllocTracking::Scope hookAllocScope(hookAllocCounter)
+
+#else
+
+#define HOOK_ALLOC_SCOPE(name)
+
+#endif
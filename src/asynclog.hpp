@@ -0,0 +1,217 @@
+#pragma once
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/sinks/sink.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+// Spdlog sink that hands records to a background thread instead of writing on the caller's thread.
+// Records are copied into a preallocated ring buffer (bounded MPSC queue, one sequence number per slot),
+// so logging from a hook is a few atomics and a memcpy. The writer drains in batches into the wrapped
+// sink, and collapses identical messages repeated within a time window into one line with a count.
+// Records that don't fit, whole or in part, are counted and reported rather than lost silently.
+class AsyncLogSink : public spdlog::sinks::sink
+{
+public:
+    static constexpr std::size_t Capacity = 4096;
+    static constexpr std::size_t MaxPayload = 224;
+
+    AsyncLogSink(std::shared_ptr<spdlog::sinks::sink> inner, std::chrono::milliseconds repeatWindow) : inner(std::move(inner)), repeatWindow(repeatWindow)
+    {
+        for (std::size_t i = 0; i < Capacity; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        writer = std::thread([this] { Run(); });
+    }
+
+    // Whatever is still queued is written here, even if the process already ended the writer thread
+    ~AsyncLogSink() override
+    {
+        stopping.store(true, std::memory_order_release);
+        if (writer.joinable())
+            writer.join();
+
+        while (Drain()) {}
+        FlushRepeats();
+        inner->flush();
+    }
+
+    void log(const spdlog::details::log_msg& msg) override
+    {
+        auto position = enqueuePosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position % Capacity];
+            auto sequence = slot->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0) {
+                // Full, the writer is behind. Never block the caller.
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->record.loggerName = msg.logger_name;
+        slot->record.level = msg.level;
+        slot->record.time = msg.time;
+        slot->record.threadId = msg.thread_id;
+        slot->record.length = std::min(msg.payload.size(), MaxPayload);
+        if (msg.payload.size() > MaxPayload)
+            truncated.fetch_add(1, std::memory_order_relaxed);
+        std::memcpy(slot->record.payload.data(), msg.payload.data(), slot->record.length);
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    // Waits, for up to a second, until the writer has written everything logged before the call
+    void flush() override
+    {
+        auto target = enqueuePosition.load(std::memory_order_relaxed);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (writtenPosition.load(std::memory_order_acquire) < target && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    void set_pattern(const std::string& pattern) override { inner->set_pattern(pattern); }
+    void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override { inner->set_formatter(std::move(formatter)); }
+
+private:
+    struct Record
+    {
+        spdlog::string_view_t loggerName;
+        spdlog::level::level_enum level = spdlog::level::info;
+        spdlog::log_clock::time_point time;
+        std::size_t threadId = 0;
+        std::size_t length = 0;
+        std::array<char, MaxPayload> payload{};
+
+        bool SameMessage(const Record& other) const
+        {
+            return level == other.level && length == other.length && std::memcmp(payload.data(), other.payload.data(), length) == 0;
+        }
+    };
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        Record record;
+    };
+
+    std::shared_ptr<spdlog::sinks::sink> inner;
+    std::chrono::milliseconds repeatWindow;
+    std::array<Slot, Capacity> slots;
+    alignas(64) std::atomic<std::size_t> enqueuePosition = 0;
+    alignas(64) std::size_t dequeuePosition = 0;
+    std::atomic<std::size_t> writtenPosition = 0;     // Everything before this is in the inner sink
+    std::atomic<std::size_t> dropped = 0;
+    std::atomic<std::size_t> truncated = 0;
+    std::atomic<bool> stopping = false;
+    std::thread writer;
+
+    // Writer thread state for collapsing repeats
+    Record last;
+    bool haveLast = false;
+    std::size_t repeats = 0;
+    spdlog::log_clock::time_point lastRepeat;
+    bool unflushed = false;
+    char warning[80];
+
+    void Write(const Record& record, spdlog::string_view_t payload)
+    {
+        spdlog::details::log_msg msg(record.time, spdlog::source_loc{}, record.loggerName, record.level, payload);
+        msg.thread_id = record.threadId;
+        inner->log(msg);
+        unflushed = true;
+    }
+
+    void FlushRepeats()
+    {
+        if (!repeats)
+            return;
+
+        char buffer[64];
+        auto result = fmt::format_to_n(buffer, sizeof(buffer), "Last message repeated {} more time(s).", repeats);
+        Record record = last;
+        record.time = lastRepeat;
+        Write(record, spdlog::string_view_t(buffer, result.size));
+        repeats = 0;
+    }
+
+    void Handle(const Record& record)
+    {
+        if (haveLast && record.SameMessage(last) && record.time - last.time < repeatWindow) {
+            ++repeats;
+            lastRepeat = record.time;
+            return;
+        }
+
+        FlushRepeats();
+        Write(record, spdlog::string_view_t(record.payload.data(), record.length));
+        last = record;
+        haveLast = true;
+    }
+
+    // Writes the first length bytes of warning as a line of the sink's own
+    void Warn(std::size_t length)
+    {
+        FlushRepeats();
+        Record record;
+        record.level = spdlog::level::warn;
+        record.time = spdlog::log_clock::now();
+        record.loggerName = last.loggerName;
+        Write(record, spdlog::string_view_t(warning, std::min(length, sizeof(warning))));
+        haveLast = false;
+    }
+
+    // Drains up to a batch of records, returns how many were written
+    std::size_t Drain()
+    {
+        std::size_t count = 0;
+        for (; count < Capacity; ++count) {
+            auto& slot = slots[dequeuePosition % Capacity];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+                break;
+
+            Handle(slot.record);
+            slot.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+            ++dequeuePosition;
+        }
+
+        if (auto lost = dropped.exchange(0, std::memory_order_relaxed))
+            Warn(fmt::format_to_n(warning, sizeof(warning), "Async Logging: Dropped {} message(s), buffer full.", lost).size);
+        if (auto cut = truncated.exchange(0, std::memory_order_relaxed))
+            Warn(fmt::format_to_n(warning, sizeof(warning), "Async Logging: Truncated {} message(s) longer than {} bytes.", cut, MaxPayload).size);
+
+        // Repeats are reported once the window has passed, even if nothing else is logged
+        if (repeats && spdlog::log_clock::now() - last.time >= repeatWindow) {
+            FlushRepeats();
+            haveLast = false;
+        }
+
+        if (unflushed) {
+            inner->flush();
+            unflushed = false;
+        }
+        writtenPosition.store(dequeuePosition, std::memory_order_release);
+        return count;
+    }
+
+    void Run()
+    {
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (!Drain())
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+};
@@ -1,5 +1,15 @@
 #include "stdafx.h"
+#include "asynclog.hpp"
 #include "helper.hpp"
+#include "hookregistry.hpp"
+#include "hudcensus.hpp"
+#include "hudhooks.hpp"
+#include "lighthook.hpp"
+#include "offsetcache.hpp"
+#include "profiler.hpp"
+#include "seqlock.hpp"
+#include "signatures.hpp"
+#include "trace.hpp"
 
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
@@ -19,40 +29,57 @@ std::filesystem::path sFixPath;
 // Ini
 inipp::Ini<char> ini;
 std::string sConfigFile = sFixName + ".ini";
+std::string sCacheFile = sFixName + ".cache";
+std::string sOffsetTableFile = sFixName + ".offsets";
 
 // Logger
 std::shared_ptr<spdlog::logger> logger;
 std::string sLogFile = sFixName + ".log";
+std::string sTraceFile = sFixName + ".trace.json";
+std::string sCensusFile = sFixName + ".hudcensus.csv";
 std::filesystem::path sExePath;
 std::string sExeName;
 
 // Aspect ratio / FOV / HUD
 std::pair DesktopDimensions = { 0,0 };
 const float fPi = 3.1415926535f;
-const float fNativeAspect = 1.7777778f;
-float fAspectRatio;
-float fAspectMultiplier;
-float fHUDWidth;
-float fHUDWidthOffset;
-float fHUDHeight;
-float fHUDHeightOffset;
+const float fNativeAspect = HUDHooks::NativeAspect;
+SeqLock<HUDHooks::Display> DisplayState;
 
 // Ini variables
 bool bCustomRes;
 int iCustomResX;
 int iCustomResY;
 bool bFixHUD;
+int iScanThreads;
+bool bOffsetCache = true;
+bool bAsyncLogging;
+int iLogRepeatWindow = 1000;
+bool bProfiling;
+int iProfilingInterval = 10;
+bool bStartupTrace;
+bool bHUDCensus;
+int iHUDCensusInterval = 30;
 
 // Variables
-int iCurrentResX;
-int iCurrentResY;
-std::string sHUDObjectName;
-short iHUDObjectX;
-short iHUDObjectY;
-std::uint8_t* MovieCapturePlane = nullptr;
+std::array<char, 32> ResolutionStringBuffer{};
+std::string_view sResolutionString;
+HUDHooks::Objects HUDObjects;
+HUDCensus HUDObjectCensus;
+LightHook::Hook HealthBars2Hook;
+LightHook::Hook FloatingMarkersHorHook;
+LightHook::Hook FloatingMarkersVertHook;
+HookRegistry HUDHookRegistry;
+bool exitProcessHooked = false;
+
+std::vector<std::uint8_t*> ScanResults(SignatureCount, nullptr);
+OffsetCache OffsetTable;     // Shipped with the fix, read only
+OffsetCache ScanCache;       // Remembered from the last launch
 
 void Logging()
 {
+    TRACE_SCOPE("Logging");
+
     // Get path to DLL
     WCHAR dllPath[_MAX_PATH] = { 0 };
     GetModuleFileNameW(thisModule, dllPath, MAX_PATH);
@@ -66,9 +93,9 @@ void Logging()
     sExeName = sExePath.filename().string();
     sExePath = sExePath.remove_filename();
 
-    // Spdlog initialisation
+    // Spdlog initialisation. Main, the game thread and the background threads all log, so the sink locks.
     try {
-        logger = spdlog::basic_logger_st(sFixName.c_str(), sExePath.string() + sLogFile, true);
+        logger = spdlog::basic_logger_mt(sFixName.c_str(), sExePath.string() + sLogFile, true);
         spdlog::set_default_logger(logger);
         spdlog::flush_on(spdlog::level::debug);
 
@@ -94,6 +121,8 @@ void Logging()
 
 void Configuration()
 {
+    TRACE_SCOPE("Configuration");
+
     // Inipp initialisation
     std::ifstream iniFile(sFixPath / sConfigFile);
     if (!iniFile) {
@@ -121,54 +150,165 @@ void Configuration()
     inipp::get_value(ini.sections["Custom Resolution"], "Width", iCustomResX);
     inipp::get_value(ini.sections["Custom Resolution"], "Height", iCustomResY);
     inipp::get_value(ini.sections["Fix HUD"], "Enabled", bFixHUD);
+    inipp::get_value(ini.sections["Performance"], "ScanThreads", iScanThreads);
+    inipp::get_value(ini.sections["Performance"], "OffsetCache", bOffsetCache);
+    inipp::get_value(ini.sections["Performance"], "AsyncLogging", bAsyncLogging);
+    inipp::get_value(ini.sections["Performance"], "LogRepeatWindow", iLogRepeatWindow);
+    inipp::get_value(ini.sections["Profiling"], "Enabled", bProfiling);
+    inipp::get_value(ini.sections["Profiling"], "FlushInterval", iProfilingInterval);
+    inipp::get_value(ini.sections["Profiling"], "StartupTrace", bStartupTrace);
+    inipp::get_value(ini.sections["Profiling"], "HUDCensus", bHUDCensus);
+    inipp::get_value(ini.sections["Profiling"], "HUDCensusInterval", iHUDCensusInterval);
 
     // Log ini parse
     spdlog_confparse(bCustomRes);
     spdlog_confparse(iCustomResX);
     spdlog_confparse(iCustomResY);
     spdlog_confparse(bFixHUD);
+    spdlog_confparse(iScanThreads);
+    spdlog_confparse(bOffsetCache);
+    spdlog_confparse(bAsyncLogging);
+    spdlog_confparse(iLogRepeatWindow);
+    spdlog_confparse(bProfiling);
+    spdlog_confparse(iProfilingInterval);
+    spdlog_confparse(bStartupTrace);
+    spdlog_confparse(bHUDCensus);
+    spdlog_confparse(iHUDCensusInterval);
 
     spdlog::info("----------");
+
+    // Hand the file sink to a background writer so hooks never wait on disk
+    if (bAsyncLogging) {
+        logger->sinks() = { std::make_shared<AsyncLogSink>(logger->sinks().front(), std::chrono::milliseconds(iLogRepeatWindow)) };
+        logger->flush_on(spdlog::level::off);
+    }
+
+    #ifdef HOOK_PROFILING
+    if (bProfiling)
+        Profiler::Start(iProfilingInterval);
+    #else
+    if (bProfiling)
+        spdlog::warn("Profiling: Enabled in config but this build was made without profiling support.");
+    #endif
 }
 
-void CalculateAspectRatio(bool bLog)
+void CalculateAspectRatio(int iResX, int iResY, bool bLog)
 {
     // Check if resolution is invalid
-    if (iCurrentResX <= 0 || iCurrentResY <= 0)
+    if (iResX <= 0 || iResY <= 0)
         return;
 
-    // Calculate aspect ratio
-    fAspectRatio = (float)iCurrentResX / (float)iCurrentResY;
-    fAspectMultiplier = fAspectRatio / fNativeAspect;
-
-    // HUD 
-    fHUDWidth = (float)iCurrentResY * fNativeAspect;
-    fHUDHeight = (float)iCurrentResY;
-    fHUDWidthOffset = (float)(iCurrentResX - fHUDWidth) / 2.00f;
-    fHUDHeightOffset = 0.00f;
-    if (fAspectRatio < fNativeAspect) {
-        fHUDWidth = (float)iCurrentResX;
-        fHUDHeight = (float)iCurrentResX / fNativeAspect;
-        fHUDWidthOffset = 0.00f;
-        fHUDHeightOffset = (float)(iCurrentResY - fHUDHeight) / 2.00f;
-    }
+    // Calculate aspect ratio and HUD bounds, then hand them to every hook at once
+    HUDHooks::Display Display;
+    Display.Calculate(iResX, iResY);
+    DisplayState.Publish(Display);
+
+    // HUD object results depend on the aspect ratio
+    HUDObjects.Invalidate();
+
+    // Add hooks carry their offsets in their stubs
+    HealthBars2Hook.SetAddend(0, Display.healthBarsOffsetX);
+    HealthBars2Hook.SetAddend(1, Display.healthBarsOffsetY);
+    FloatingMarkersHorHook.SetAddend(0, Display.wider ? Display.hudWidthOffset : 0.00f);
+    FloatingMarkersVertHook.SetAddend(0, Display.narrower ? Display.hudHeightOffset : 0.00f);
+
+    // Hooks with nothing to do at this aspect ratio are taken out of the game's code, off this thread
+    HUDHookRegistry.Request(Display);
 
     // Log details about current resolution
     if (bLog) {
         spdlog::info("----------");
-        spdlog::info("Current Resolution: Resolution: {:d}x{:d}", iCurrentResX, iCurrentResY);
-        spdlog::info("Current Resolution: fAspectRatio: {}", fAspectRatio);
-        spdlog::info("Current Resolution: fAspectMultiplier: {}", fAspectMultiplier);
-        spdlog::info("Current Resolution: fHUDWidth: {}", fHUDWidth);
-        spdlog::info("Current Resolution: fHUDHeight: {}", fHUDHeight);
-        spdlog::info("Current Resolution: fHUDWidthOffset: {}", fHUDWidthOffset);
-        spdlog::info("Current Resolution: fHUDHeightOffset: {}", fHUDHeightOffset);
+        spdlog::info("Current Resolution: Resolution: {:d}x{:d}", Display.resX, Display.resY);
+        spdlog::info("Current Resolution: fAspectRatio: {}", Display.aspectRatio);
+        spdlog::info("Current Resolution: fAspectMultiplier: {}", Display.aspectMultiplier);
+        spdlog::info("Current Resolution: fHUDWidth: {}", Display.hudWidth);
+        spdlog::info("Current Resolution: fHUDHeight: {}", Display.hudHeight);
+        spdlog::info("Current Resolution: fHUDWidthOffset: {}", Display.hudWidthOffset);
+        spdlog::info("Current Resolution: fHUDHeightOffset: {}", Display.hudHeightOffset);
         spdlog::info("----------");
     }
 }
 
+bool FeatureEnabled(Feature feature)
+{
+    switch (feature) {
+    case Feature::CustomResolution: return bCustomRes;
+    case Feature::FixHUD: return bFixHUD;
+    default: return true;
+    }
+}
+
+void Scan(SignatureStage stage, Scanner::WorkerPool& pool)
+{
+    TRACE_SCOPE(stage == SignatureStage::Critical ? "Scan: Critical" : "Scan: Deferred");
+
+    const auto& module = Memory::GetModule(exeModule);
+    std::array<std::uint64_t, SignatureCount> hashes{};
+
+    // Reuse offsets precomputed for known builds or remembered from the last launch if they
+    // still match. The critical stage always runs first.
+    if (stage == SignatureStage::Critical) {
+        TRACE_SCOPE("Offset Cache: Load");
+        if (OffsetTable.Load(sFixPath / sOffsetTableFile))
+            spdlog::info("Offset Cache: Loaded precomputed offsets for {} builds.", OffsetTable.Builds().size());
+        if (bOffsetCache)
+            ScanCache.Load(sFixPath / sCacheFile);
+    }
+
+    Scanner::Batch batch;
+    std::vector<std::size_t> batchSignatures;
+    std::size_t stageCount = 0;
+    for (std::size_t i = 0; i < SignatureCount; ++i) {
+        const auto& [name, pattern, region, signatureStage, feature] = Signatures[i];
+        if (signatureStage != stage || !FeatureEnabled(feature))
+            continue;
+        ++stageCount;
+        hashes[i] = OffsetCache::Hash(pattern, region);
+
+        // The table first, so a corrected table entry wins over what an earlier launch remembered
+        auto cached = [&](const OffsetCache& cache) {
+            auto rva = cache.Find(module.timestamp, hashes[i]);
+            if (rva && OffsetCache::Validate(module, *rva, pattern, region))
+                ScanResults[i] = (std::uint8_t*)exeModule + *rva;
+            return ScanResults[i] != nullptr;
+        };
+        if (cached(OffsetTable) || cached(ScanCache))
+            continue;
+
+        batch.Add(pattern, false, region);
+        batchSignatures.push_back(i);
+    }
+
+    if (stageCount == 0)
+        return;
+    spdlog::info("Offset Cache: {} of {} signatures cached.", stageCount - batchSignatures.size(), stageCount);
+    if (batchSignatures.empty())
+        return;
+
+    // Walk each section once for every signature that can live there
+    std::vector<std::uint8_t*> results;
+    {
+        TRACE_SCOPE("Pattern Scan");
+        results = Memory::PatternScanBatch(exeModule, batch, &pool);
+    }
+    for (std::size_t id = 0; id < batchSignatures.size(); ++id) {
+        auto i = batchSignatures[id];
+        ScanResults[i] = results[id];
+        if (results[id])
+            ScanCache.Store(module.timestamp, hashes[i], static_cast<std::uint32_t>(results[id] - (std::uint8_t*)exeModule));
+        else
+            ScanCache.Erase(module.timestamp, hashes[i]);
+    }
+
+    TRACE_SCOPE("Offset Cache: Save");
+    if (bOffsetCache && !ScanCache.Save(sFixPath / sCacheFile))
+        spdlog::error("Offset Cache: Failed to write {}", (sFixPath / sCacheFile).string());
+}
+
 void Resolution()
 {
+    TRACE_SCOPE("Resolution");
+
     // Grab desktop resolution
     DesktopDimensions = Util::GetPhysicalDesktopDimensions();
 
@@ -180,33 +320,43 @@ void Resolution()
         }
 
         // Resolution lists
-        std::uint8_t* ResolutionListScanResult = Memory::PatternScan(exeModule, "C0 03 00 00 00 04 00 00 60 04 00 00 00 05 00 00");
+        std::uint8_t* ResolutionListScanResult = ScanResults[ResolutionListSig];
         if (ResolutionListScanResult) {
             spdlog::info("Resolution List: Address is {:s}+{:x}", sExeName.c_str(), ResolutionListScanResult - (std::uint8_t*)exeModule);
 
             // Overwrite 3840x2160
-            Memory::Write(ResolutionListScanResult + 0x24, iCustomResX);
-            Memory::Write(ResolutionListScanResult + 0x54, iCustomResY);
+            Protect::WriteSession session;
+            session.Write(ResolutionListScanResult + 0x24, iCustomResX);
+            session.Write(ResolutionListScanResult + 0x54, iCustomResY);
         }
         else {
             spdlog::error("Resolution List: Pattern scan failed.");
         }
 
         // Resolution string
-        std::uint8_t* ResolutionStringScanResult = Memory::PatternScan(exeModule, "48 8B ?? 45 33 ?? 4D ?? ?? 49 ?? ?? 41 ?? ?? ?? E8 ?? ?? ?? ?? 45 33 ??");
+        std::uint8_t* ResolutionStringScanResult = ScanResults[ResolutionStringSig];
         if (ResolutionStringScanResult) {
+            TRACE_SCOPE("Install: Resolution String");
             spdlog::info("Resolution String: Address is {:s}+{:x}", sExeName.c_str(), ResolutionStringScanResult - (std::uint8_t*)exeModule);
             static SafetyHookMid ResolutionStringMidHook{};
+            // Format the replacement once, the hook only copies it
+            auto resLast = ResolutionStringBuffer.data() + ResolutionStringBuffer.size();
+            auto resEnd = std::to_chars(ResolutionStringBuffer.data(), resLast, iCustomResX).ptr;
+            *resEnd++ = 'x';
+            resEnd = std::to_chars(resEnd, resLast, iCustomResY).ptr;
+            sResolutionString = std::string_view(ResolutionStringBuffer.data(), resEnd);
+
             ResolutionStringMidHook = safetyhook::create_mid(ResolutionStringScanResult,
                 [](SafetyHookContext& ctx) {
-                    const std::string oldRes = "3840x2160";
-                    std::string newRes = std::to_string(iCustomResX) + "x" + std::to_string(iCustomResY);
+                    HOOK_SCOPE("Resolution String");
+                    constexpr std::string_view oldRes = "3840x2160";
 
                     char* currentString = (char*)ctx.rax;
-                    if (strncmp(currentString, oldRes.c_str(), oldRes.size()) == 0) {
-                        if (newRes.size() <= oldRes.size()) {
-                            std::memcpy(currentString, newRes.c_str(), newRes.size() + 1);
-                            spdlog::info("Resolution String: Replaced 3840x2160 with {}", newRes);
+                    if (strncmp(currentString, oldRes.data(), oldRes.size()) == 0) {
+                        if (sResolutionString.size() <= oldRes.size()) {
+                            std::memcpy(currentString, sResolutionString.data(), sResolutionString.size());
+                            currentString[sResolutionString.size()] = '\0';
+                            spdlog::info("Resolution String: Replaced 3840x2160 with {}", sResolutionString);
                         }
                     }
                 });
@@ -217,266 +367,257 @@ void Resolution()
     }
 }
 
-void HUD()
+void DumpHUDCensus()
 {
-    if (bFixHUD) {
-        // HUD Size 
-        std::uint8_t* HUDSizeScanResult = Memory::PatternScan(exeModule, "F3 0F ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? F3 0F ?? ?? ?? 48 83 ?? ?? E8 ?? ?? ?? ??");
-        std::uint8_t* StartupHUDSizeScanResult = Memory::PatternScan(exeModule, "F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? ?? F3 0F ?? ?? ?? E8 ?? ?? ?? ?? 48 8B ?? E8 ?? ?? ?? ??");
-        if (HUDSizeScanResult) {
-            spdlog::info("HUD: Size: Address is {:s}+{:x}", sExeName.c_str(), HUDSizeScanResult - (std::uint8_t*)exeModule);
-            spdlog::info("HUD: Size: Startup: Address is {:s}+{:x}", sExeName.c_str(), StartupHUDSizeScanResult - (std::uint8_t*)exeModule);
-
-            // Get HUD X and HUD Y
-            static std::uint8_t* HUDSizeXAddr = Memory::GetAbsolute(StartupHUDSizeScanResult + 0xC);
-            static std::uint8_t* HUDSizeYAddr = Memory::GetAbsolute(StartupHUDSizeScanResult + 0x4);
-
-            auto HUDSizeMidHook = [](SafetyHookContext& ctx) {
-                // Write defaults
-                Memory::Write(HUDSizeXAddr, 1920.00f);
-                Memory::Write(HUDSizeYAddr, 1080.00f);
-
-                ctx.xmm6.f32[0] = 1080.00f;
-                ctx.xmm7.f32[0] = 1920.00f;
-
-                int iResX = static_cast<int>(ctx.xmm0.f32[0]);
-                int iResY = static_cast<int>(ctx.xmm1.f32[0]);
+    if (!HUDObjectCensus.Dump(sExePath / sCensusFile))
+        spdlog::error("HUD Census: Failed to write {}", (sExePath / sCensusFile).string());
+    else if (HUDObjectCensus.Dropped())
+        spdlog::warn("HUD Census: Table is full, {} objects were not recorded.", HUDObjectCensus.Dropped());
+}
 
-                // Log resolution
-                if (iResX != iCurrentResX || iResY != iCurrentResY) {
-                    iCurrentResX = iResX;
-                    iCurrentResY = iResY;
-                    CalculateAspectRatio(true);
-                }
+std::mutex hudCensusStopMutex;
+std::condition_variable hudCensusStopVar;
+bool hudCensusStopping = false;
+std::thread HUDCensusThread;
 
-                if (fAspectRatio > fNativeAspect) {
-                    Memory::Write(HUDSizeXAddr, 1080.00f * fAspectRatio);
-                    Memory::Write(HUDSizeYAddr, 1080.00f);
+// Dumps the census every interval until StopHUDCensus, the file is never written under the lock
+void RunHUDCensus()
+{
+    std::unique_lock lock(hudCensusStopMutex);
+    while (!hudCensusStopVar.wait_for(lock, std::chrono::seconds(std::max(iHUDCensusInterval, 1)), [] { return hudCensusStopping; })) {
+        lock.unlock();
+        DumpHUDCensus();
+        lock.lock();
+    }
+}
 
-                    ctx.xmm7.f32[0] = 1080.00f * fAspectRatio;
-                    ctx.xmm6.f32[0] = 1080.00f;
-                }
-                else if (fAspectRatio < fNativeAspect) {
-                    Memory::Write(HUDSizeXAddr, 1920.00f);
-                    Memory::Write(HUDSizeYAddr, 1920.00f / fAspectRatio);
+// Joins the dump thread and writes what was recorded since its last dump
+void StopHUDCensus()
+{
+    if (!HUDCensusThread.joinable())
+        return;
 
-                    ctx.xmm7.f32[0] = 1920.00f;
-                    ctx.xmm6.f32[0] = 1920.00f / fAspectRatio;
-                }
-                };
+    {
+        std::lock_guard lock(hudCensusStopMutex);
+        hudCensusStopping = true;
+    }
+    hudCensusStopVar.notify_all();
+    HUDCensusThread.join();
+    DumpHUDCensus();
+}
 
-            // Apply hooks
-            static SafetyHookMid HUDSizeHook = safetyhook::create_mid(HUDSizeScanResult, HUDSizeMidHook);
-            static SafetyHookMid StartupHUDSizeHook = safetyhook::create_mid(StartupHUDSizeScanResult, HUDSizeMidHook);
-        }
-        else {
-            spdlog::error("HUD: Size: Pattern scan failed.");
-        }
+void HUD()
+{
+    TRACE_SCOPE("HUD");
 
+    if (bFixHUD) {
         // Health Bars 
-        std::uint8_t* HealthBars1ScanResult = Memory::PatternScan(exeModule, "0F 29 ?? ?? ?? 48 8B ?? ?? ?? 48 83 ?? ?? 74 ?? F3 0F ?? ?? ?? ?? ?? ?? 0F ?? ?? 77 ??");
-        std::uint8_t* HealthBars2ScanResult = Memory::PatternScan(exeModule, "F3 0F ?? ?? F3 0F ?? ?? 66 0F ?? ?? ?? 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? E8 ?? ?? ?? ?? 84 ?? 74 ??");
+        std::uint8_t* HealthBars1ScanResult = ScanResults[HealthBars1Sig];
+        std::uint8_t* HealthBars2ScanResult = ScanResults[HealthBars2Sig];
         if (HealthBars1ScanResult && HealthBars2ScanResult) {
+            TRACE_SCOPE("Install: Health Bars");
             spdlog::info("HUD: Health Bars: 1: Address is {:s}+{:x}", sExeName.c_str(), HealthBars1ScanResult - (std::uint8_t*)exeModule);
-            static SafetyHookMid HealthBars1MidHook{};
-            HealthBars1MidHook = safetyhook::create_mid(HealthBars1ScanResult,
-                [](SafetyHookContext& ctx) {
-                    if (fAspectRatio > fNativeAspect)
-                        ctx.xmm6.f32[0] = 1920.00f;
-                    else if (fAspectRatio < fNativeAspect)
-                        ctx.xmm5.f32[0] = 1080.00f;
+            static LightHook::Hook HealthBars1MidHook{};
+            HealthBars1MidHook = LightHook::Hook::Create<LightHook::Xmm5 | LightHook::Xmm6>(HealthBars1ScanResult,
+                [](LightHook::Context& ctx) {
+                    HOOK_SCOPE("Health Bars 1");
+                    HUDHooks::HealthBars1(ctx, DisplayState.Load());
                 });
+            HUDHookRegistry.Add("Health Bars 1", HealthBars1MidHook, HookRegistry::NotNative);
 
             spdlog::info("HUD: Health Bars: 2: Address is {:s}+{:x}", sExeName.c_str(), HealthBars2ScanResult - (std::uint8_t*)exeModule);
-            static SafetyHookMid HealthBars2MidHook{};
-            HealthBars2MidHook = safetyhook::create_mid(HealthBars2ScanResult,
-                [](SafetyHookContext& ctx) {
-                    if (fAspectRatio > fNativeAspect)
-                        ctx.xmm3.f32[0] += ((1080.00f * fAspectRatio) - 1920.00f) / 2.00f;
-                    else if (fAspectRatio < fNativeAspect)
-                        ctx.xmm4.f32[0] += ((1920.00f / fAspectRatio) - 1080.00f) / 2.00f;
-                });
+            // xmm3 += offset x, xmm4 += offset y, each zero unless the aspect ratio calls for it
+            HealthBars2Hook = LightHook::Hook::CreateAdd(HealthBars2ScanResult, { 3, 4 });
+            HUDHookRegistry.Add("Health Bars 2", HealthBars2Hook, HookRegistry::NotNative);
         }
         else {
             spdlog::error("HUD: Health Bars: Pattern scan(s) failed.");
         }
 
         // Floating Markers
-        std::uint8_t* FloatingMarkersScanResult = Memory::PatternScan(exeModule, "F3 0F ?? ?? 66 0F ?? ?? ?? 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? E8 ?? ?? ?? ??");
+        std::uint8_t* FloatingMarkersScanResult = ScanResults[FloatingMarkersSig];
         if (FloatingMarkersScanResult) {
+            TRACE_SCOPE("Install: Floating Markers");
             spdlog::info("HUD: Floating Markers: Address is {:s}+{:x}", sExeName.c_str(), FloatingMarkersScanResult - (std::uint8_t*)exeModule);
-            static SafetyHookMid FloatingMarkersHorMidHook{};
-            FloatingMarkersHorMidHook = safetyhook::create_mid(FloatingMarkersScanResult,
-                [](SafetyHookContext& ctx) {
-                    if (fAspectRatio > fNativeAspect)
-                        ctx.xmm0.f32[0] += fHUDWidthOffset;
-                });
-
-            static SafetyHookMid FloatingMarkersVertMidHook{};
-            FloatingMarkersVertMidHook = safetyhook::create_mid(FloatingMarkersScanResult + 0x18,
-                [](SafetyHookContext& ctx) {
-                    if (fAspectRatio < fNativeAspect)
-                        ctx.xmm0.f32[0] += fHUDHeightOffset;
-                });
+            // xmm0 += HUD width offset when wider, HUD height offset when narrower
+            FloatingMarkersHorHook = LightHook::Hook::CreateAdd(FloatingMarkersScanResult, { 0 });
+            FloatingMarkersVertHook = LightHook::Hook::CreateAdd(FloatingMarkersScanResult + 0x18, { 0 });
+            HUDHookRegistry.Add("Floating Markers Horizontal", FloatingMarkersHorHook, HookRegistry::Wider);
+            HUDHookRegistry.Add("Floating Markers Vertical", FloatingMarkersVertHook, HookRegistry::Narrower);
         }
         else {
             spdlog::error("HUD: Floating Markers: Pattern scan failed.");
         }      
 
+        // Every hook above is registered, resizes toggle them on the registry's own thread
+        HUDHookRegistry.Start();
+
         // HUD Objects
-        std::uint8_t* HUDObjectsScanResult = Memory::PatternScan(exeModule, "41 8B ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ?? 41 ?? 01 00 00 00 89 ?? ?? ?? ?? ?? ??");
+        std::uint8_t* HUDObjectsScanResult = ScanResults[HUDObjectsSig];
         if (HUDObjectsScanResult) {
-            static int iCapCount = 0;
+            TRACE_SCOPE("Install: HUD Objects");
 
             spdlog::info("HUD: Objects: Address is {:s}+{:x}", sExeName.c_str(), HUDObjectsScanResult - (std::uint8_t*)exeModule);
-            static SafetyHookMid HUDObjectsMidHook{};
-            HUDObjectsMidHook = safetyhook::create_mid(HUDObjectsScanResult + 0x5,
-                [](SafetyHookContext& ctx) {
-                    if (ctx.r12) {
-                        sHUDObjectName = (char*)ctx.r12;
-                        iHUDObjectX = *reinterpret_cast<short*>(ctx.r12 + 0x60);
-                        iHUDObjectY = *reinterpret_cast<short*>(ctx.r12 + 0x62);
-
-                        // Grab capture plane for movies, luckily it's always the first one
-                        if (sHUDObjectName.contains("capture_plane_full_rgba8") && !MovieCapturePlane)
-                            MovieCapturePlane = (std::uint8_t*)ctx.r12;
-
-                        // Non-movie capture planes
-                        if (sHUDObjectName.contains("capture_plane_full_rgba8") && (std::uint8_t*)ctx.r12 != MovieCapturePlane) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Capture Plane: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(iHUDObjectY * fAspectRatio);
-                            }
-                            else if (fAspectRatio < fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>((short)ceilf(iHUDObjectX / fAspectRatio)) << 16) | iHUDObjectX;
-                            }
-                        }
 
-                        // Map
-                        if (sHUDObjectName.contains("bg_strategy_book") && (iHUDObjectX == 1920 && iHUDObjectY == 1080) || sHUDObjectName.contains("PIC_gra") && (iHUDObjectX == 1920 && iHUDObjectY == 108) || sHUDObjectName.contains("parts_book_top_frame_01") && (iHUDObjectX == 1920 && iHUDObjectY == 1080) || sHUDObjectName.contains("parts_book_top_frame_02")) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Map: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(iHUDObjectX * fAspectMultiplier);
-                            }
-                        }                       
-
-                        // Damage frame
-                        if (sHUDObjectName.contains("PIC_bg_frame_damage_")) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Damage Frame: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (sHUDObjectName.contains("PIC_bg_frame_damage_l")) {
-                                if (fAspectRatio > fNativeAspect) {
-                                    ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(540.00f * fAspectRatio);
-                                    *reinterpret_cast<float*>(ctx.r12 + 0x50) = -ceilf(540.00f * fAspectRatio);
-                                }
-                            }
-                            else if (sHUDObjectName.contains("PIC_bg_frame_damage_r")) {
-                                if (fAspectRatio > fNativeAspect) {
-                                    ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(540.00f * fAspectRatio);
-                                    *reinterpret_cast<float*>(ctx.r12 + 0x50) = ceilf(540.00f * fAspectRatio);
-                                }
-                            }
-                        }
+            // Recorded from the hook, written out from here so the game thread never touches the file
+            if (bHUDCensus) {
+                HUDObjects.census = &HUDObjectCensus;
+                HUDCensusThread = std::thread(RunHUDCensus);
+                spdlog::info("HUD Census: Writing {} every {} seconds.", (sExePath / sCensusFile).string(), iHUDCensusInterval);
+            }
 
-                        // Pause menu
-                        if (sHUDObjectName.contains("PIC_common_square_bl") || sHUDObjectName.contains("PIC_parts_header_bg_tab")) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Pause Menu: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(iHUDObjectX * fAspectMultiplier);
-                            }
-                        }
+            static LightHook::Hook HUDObjectsMidHook{};
+            HUDObjectsMidHook = LightHook::Hook::Create<LightHook::Rax | LightHook::R12>(HUDObjectsScanResult + 0x5,
+                [](LightHook::Context& ctx) {
+                    HOOK_SCOPE("HUD Objects");
+                    HUDHooks::HUDObjects(ctx, HUDObjects, DisplayState);
+                });
+        }
+        else {
+            spdlog::error("HUD Objects: Pattern scan failed.");
+        }
 
-                        // Base background
-                        if (iHUDObjectX == 2600 && sHUDObjectName.contains("WIN_base_system_bg")) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Base BG: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(1463 * fAspectRatio);
-                            }
-                            else if (fAspectRatio < fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>((short)ceilf(iHUDObjectX / fAspectRatio)) << 16) | iHUDObjectX;
-                            }
-                        }
+        // HUD Size, installed last as it publishes the display state the hooks above depend on
+        std::uint8_t* HUDSizeScanResult = ScanResults[HUDSizeSig];
+        std::uint8_t* StartupHUDSizeScanResult = ScanResults[StartupHUDSizeSig];
+        if (HUDSizeScanResult && StartupHUDSizeScanResult) {
+            TRACE_SCOPE("Install: HUD Size");
+            spdlog::info("HUD: Size: Address is {:s}+{:x}", sExeName.c_str(), HUDSizeScanResult - (std::uint8_t*)exeModule);
+            spdlog::info("HUD: Size: Startup: Address is {:s}+{:x}", sExeName.c_str(), StartupHUDSizeScanResult - (std::uint8_t*)exeModule);
 
-                        // Fades/masks
-                        if ((sHUDObjectName.contains("PIC_bg_rect_window") || sHUDObjectName.contains("PIC_mask_bg") || sHUDObjectName.contains("PIC_square_w") || sHUDObjectName.contains("PIC_black")) && iHUDObjectX >= 1920 && iHUDObjectY >= 1080) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Fades: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(iHUDObjectX * fAspectMultiplier);
-                            }
-                            else if (fAspectRatio < fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>((short)ceilf(iHUDObjectX / fAspectRatio) << 16) | iHUDObjectX);
-                            }
-                        }
+            // Get HUD X and HUD Y from the globals the startup site reads, it loads height then width
+            auto HUDSizeGlobals = Memory::GetDataReferences(exeModule, StartupHUDSizeScanResult, SignaturePatterns::StartupHUDSize.size());
+            if (HUDSizeGlobals.size() < 2) {
+                spdlog::error("HUD: Size: Startup site reads {} globals, expected 2.", HUDSizeGlobals.size());
+                return;
+            }
+            static std::uint8_t* HUDSizeYAddr = HUDSizeGlobals[0];
+            static std::uint8_t* HUDSizeXAddr = HUDSizeGlobals[1];
 
-                        // Menu letterboxing
-                        if (iHUDObjectX == 1920 && sHUDObjectName.contains("PIC_square_w")) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Menu Letterboxing: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(iHUDObjectX * fAspectMultiplier);
-                            }
-                        }
+            // Static so the hook never allocates its page list, restored after every call so the
+            // globals keep their own protection in between
+            static Protect::WriteSession HUDSizeWrites;
 
-                        // Cutscene letterboxing
-                        if (sHUDObjectName.contains("letterbox") && iHUDObjectX >= 1920) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Letterboxing: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(iHUDObjectX * fAspectMultiplier);
-                            }
-                        }
+            auto HUDSizeMidHook = [](LightHook::Context& ctx) {
+                HOOK_SCOPE("HUD Size");
+                int iResX = static_cast<int>(ctx.xmm0.f32[0]);
+                int iResY = static_cast<int>(ctx.xmm1.f32[0]);
 
-                        // Gradient background
-                        if (iHUDObjectX == 2880 && sHUDObjectName.contains("PIC_bottomGradation")) {
-                            #ifdef _DEBUG
-                            spdlog::info("HUD Objects: Gradient Background: sHUDObjectName = {:x} - {} - {}x{}", ctx.r12, sHUDObjectName, iHUDObjectX, iHUDObjectY);
-                            #endif
-                            if (fAspectRatio > fNativeAspect) {
-                                ctx.rax = (static_cast<uintptr_t>(iHUDObjectY) << 16) | (short)ceilf(1620 * fAspectRatio);
-                            }
-                        }
-                    }
-                });
+                // Log resolution
+                auto Display = DisplayState.Load();
+                if (iResX != Display.resX || iResY != Display.resY) {
+                    CalculateAspectRatio(iResX, iResY, true);
+                    Display = DisplayState.Load();
+                }
+
+                // Unchanged values are skipped
+                HUDSizeWrites.Write(HUDSizeXAddr, Display.hudSizeX);
+                HUDSizeWrites.Write(HUDSizeYAddr, Display.hudSizeY);
+                HUDSizeWrites.Restore();
+
+                ctx.xmm7.f32[0] = Display.hudSizeX;
+                ctx.xmm6.f32[0] = Display.hudSizeY;
+                };
+
+            // Apply hooks
+            constexpr auto HUDSizeRegisters = LightHook::Xmm0 | LightHook::Xmm1 | LightHook::Xmm6 | LightHook::Xmm7;
+            static LightHook::Hook HUDSizeHook = LightHook::Hook::Create<HUDSizeRegisters>(HUDSizeScanResult, HUDSizeMidHook);
+            static LightHook::Hook StartupHUDSizeHook = LightHook::Hook::Create<HUDSizeRegisters>(StartupHUDSizeScanResult, HUDSizeMidHook);
         }
         else {
-            spdlog::error("HUD Objects: Pattern scan failed.");
+            spdlog::error("HUD: Size: Pattern scan(s) failed.");
         }
     }
 }
 
-std::mutex mainThreadFinishedMutex;
-std::condition_variable mainThreadFinishedVar;
-bool mainThreadFinished = false;
+std::mutex criticalStageFinishedMutex;
+std::condition_variable criticalStageFinishedVar;
+bool criticalStageFinished = false;
+
+void LogStage(const char* stage, std::chrono::steady_clock::time_point start)
+{
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    spdlog::info("Startup: {} stage finished in {:.2f} ms.", stage, elapsed.count());
+}
 
 DWORD __stdcall Main(void*)
 {
+    auto start = std::chrono::steady_clock::now();
     Logging();
     Configuration();
-    Resolution();
-    HUD();
+    if (!exitProcessHooked)
+        spdlog::warn("Shutdown: Game doesn't import ExitProcess, the final HUD census and reports won't be written.");
+
+    // One pool for both stages, using every core unless a thread count is set
+    if (iScanThreads <= 0)
+        iScanThreads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, 8);
+    Scanner::WorkerPool pool(iScanThreads);
+
+    // Patches the game reads before its options are built, the game thread waits for these
+    {
+        TRACE_SCOPE("Critical Stage");
+        Scan(SignatureStage::Critical, pool);
+        Resolution();
+    }
+    LogStage("Critical", start);
+
+    {
+        std::lock_guard lock(criticalStageFinishedMutex);
+        criticalStageFinished = true;
+        criticalStageFinishedVar.notify_all();
+    }
 
+    // Everything else is installed while the game carries on loading
+    auto deferredStart = std::chrono::steady_clock::now();
     {
-        std::lock_guard lock(mainThreadFinishedMutex);
-        mainThreadFinished = true;
-        mainThreadFinishedVar.notify_all();
+        TRACE_SCOPE("Deferred Stage");
+        Scan(SignatureStage::Deferred, pool);
+        HUD();
+    }
+    LogStage("Deferred", deferredStart);
+
+    // Startup is over, nothing records spans after this
+    if (bStartupTrace) {
+        if (Trace::Write(sExePath / sTraceFile))
+            spdlog::info("Startup Trace: Wrote {}", (sExePath / sTraceFile).string());
+        else
+            spdlog::error("Startup Trace: Failed to write {}", (sExePath / sTraceFile).string());
+        if (Trace::Dropped())
+            spdlog::warn("Startup Trace: {} events did not fit in the buffer.", Trace::Dropped());
     }
 
     return true;
 }
 
+// Everything that joins threads or writes files on the way out. DllMain runs under the loader
+// lock after the other threads are gone, so this runs from the game's ExitProcess call instead.
+void Shutdown()
+{
+    static std::atomic<bool> shutDown = false;
+    if (shutDown.exchange(true))
+        return;
+
+    HUDHookRegistry.Stop();
+    StopHUDCensus();
+    #ifdef HOOK_PROFILING
+    Profiler::Stop();
+    #endif
+    #ifdef HOOK_ALLOC_TRACKING
+    AllocTracking::Report();
+    #endif
+
+    if (logger)
+        logger->flush();
+}
+
+void(__stdcall* ExitProcess_Fn)(UINT uExitCode);
+
+void __stdcall ExitProcess_Hook(UINT uExitCode)
+{
+    Shutdown();
+    ExitProcess_Fn(uExitCode);
+}
+
 std::mutex multiByteToWideCharHookMutex;
 bool multiByteToWideCharHookCalled = false;
 int(__stdcall* MultiByteToWideChar_Fn)(UINT CodePage, DWORD dwFlags, LPCCH lpMultiByteStr, int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar);
@@ -490,10 +631,11 @@ int __stdcall MultiByteToWideChar_Hook(UINT CodePage, DWORD dwFlags, LPCCH lpMul
             multiByteToWideCharHookCalled = true;
             Memory::HookIAT(exeModule, "KERNEL32.dll", MultiByteToWideChar_Hook, MultiByteToWideChar_Fn);
 
-            if (!mainThreadFinished)
+            if (!criticalStageFinished)
             {
-                std::unique_lock finishedLock(mainThreadFinishedMutex);
-                mainThreadFinishedVar.wait(finishedLock, [] { return mainThreadFinished; });
+                TRACE_SCOPE("Game Thread Blocked");
+                std::unique_lock finishedLock(criticalStageFinishedMutex);
+                criticalStageFinishedVar.wait(finishedLock, [] { return criticalStageFinished; });
             }
         }
     }
@@ -512,6 +654,9 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         {
             MultiByteToWideChar_Fn = decltype(MultiByteToWideChar_Fn)(GetProcAddress(kernel32, "MultiByteToWideChar"));
             Memory::HookIAT(exeModule, "KERNEL32.dll", MultiByteToWideChar_Fn, MultiByteToWideChar_Hook);
+
+            ExitProcess_Fn = decltype(ExitProcess_Fn)(GetProcAddress(kernel32, "ExitProcess"));
+            exitProcessHooked = Memory::HookIAT(exeModule, "KERNEL32.dll", ExitProcess_Fn, ExitProcess_Hook);
         }
 
         HANDLE mainHandle = CreateThread(NULL, 0, Main, 0, NULL, 0);
@@ -521,9 +666,18 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         }
         break;
     }
+    case DLL_PROCESS_DETACH:
+        // Shutdown didn't run. The threads are already gone at process exit and can't be joined
+        // under the loader lock, so only keep their destructors from terminating the process.
+        if (HUDCensusThread.joinable())
+            HUDCensusThread.detach();
+        #ifdef HOOK_PROFILING
+        if (Profiler::FlushThread.joinable())
+            Profiler::FlushThread.detach();
+        #endif
+        break;
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
-    case DLL_PROCESS_DETACH:
         break;
     }
     return TRUE;
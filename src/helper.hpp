@@ -1,121 +1,215 @@
 #include "stdafx.h"
+#include "pe.hpp"
+#include "protect.hpp"
+#include "scanner.hpp"
+#include "xrefs.hpp"
 
 namespace Memory
 {
+    // One-off write. Use a Protect::WriteSession for anything written more than once.
     template<typename T>
     void Write(std::uint8_t* writeAddress, T value)
     {
-        DWORD oldProtect;
-        VirtualProtect((LPVOID)(writeAddress), sizeof(T), PAGE_EXECUTE_WRITECOPY, &oldProtect);
-        *(reinterpret_cast<T*>(writeAddress)) = value;
-        VirtualProtect((LPVOID)(writeAddress), sizeof(T), oldProtect, &oldProtect);
+        Protect::WriteSession session;
+        session.Write(writeAddress, value);
     }
 
     void PatchBytes(std::uint8_t* address, const char* pattern, unsigned int numBytes)
     {
-        DWORD oldProtect;
-        VirtualProtect((LPVOID)address, numBytes, PAGE_EXECUTE_READWRITE, &oldProtect);
-        memcpy((LPVOID)address, pattern, numBytes);
-        VirtualProtect((LPVOID)address, numBytes, oldProtect, &oldProtect);
+        Protect::WriteSession session;
+        session.WriteBytes(address, pattern, numBytes);
     }
 
-    std::vector<int> pattern_to_byte(const char* pattern)
+    struct BytePatch
     {
-        auto bytes = std::vector<int>{};
-        auto start = const_cast<char*>(pattern);
-        auto end = const_cast<char*>(pattern) + strlen(pattern);
+        std::uint8_t* address;
+        const char* bytes;
+        std::size_t size;
+    };
 
-        for (auto current = start; current < end; ++current) {
-            if (*current == '?') {
-                ++current;
-                if (*current == '?')
-                    ++current;
-                bytes.push_back(-1);
-            }
-            else {
-                bytes.push_back(strtoul(current, &current, 16));
-            }
+    // Applies every patch or none of them. Protection is changed once per page.
+    bool PatchBytes(std::initializer_list<BytePatch> patches)
+    {
+        Protect::Transaction transaction;
+        for (const auto& patch : patches) {
+            if (!patch.address || !transaction.Patch(patch.address, patch.bytes, patch.size))
+                return false;
         }
-        return bytes;
+        transaction.Commit();
+        return true;
     }
 
-    std::uint8_t* PatternScan(void* module, const char* signature) 
+    // Section layout of a module, parsed once and cached
+    const PE::Module& GetModule(void* module)
     {
-        auto dosHeader = (PIMAGE_DOS_HEADER)module;
-        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
+        static std::map<void*, PE::Module> modules;
+        auto it = modules.find(module);
+        if (it == modules.end())
+            it = modules.emplace(module, PE::Load(module)).first;
+        return it->second;
+    }
 
-        auto sizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
-        auto patternBytes = pattern_to_byte(signature);
+    // The image as the flat scans have always covered it, every byte but the last
+    std::span<const std::byte> FlatImage(void* module)
+    {
+        auto image = PE::Bytes(GetModule(module));
+        return image.first(image.size() - 1);
+    }
+
+    std::uint8_t* PatternScan(void* module, const char* signature) 
+    {
+        auto pattern = Scanner::Parse(signature);
         auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
 
-        auto s = patternBytes.size();
-        auto d = patternBytes.data();
+        // The final byte of the image has never been scanned, keep results identical
+        auto offset = Scanner::FindFirst(FlatImage(module), pattern);
+        if (offset != Scanner::npos) {
+            return &scanBytes[offset];
+        }
 
-        for (auto i = 0ul; i < sizeOfImage - s; ++i) {
-            bool found = true;
-            for (auto j = 0ul; j < s; ++j) {
-                if (scanBytes[i + j] != d[j] && d[j] != -1) {
-                    found = false;
-                    break;
-                }
-            }
-            if (found) {
-                return &scanBytes[i];
-            }
+        return nullptr;
+    }
+
+    // Globals read or written by the instructions in [address, address + size), in address order.
+    // Only the site is decoded, the hooks never need references from the rest of the image.
+    std::vector<std::uint8_t*> GetDataReferences(void* module, std::uint8_t* address, std::size_t size)
+    {
+        auto begin = static_cast<std::uint32_t>(address - reinterpret_cast<std::uint8_t*>(module));
+        auto index = XRefs::Build(GetModule(module), begin, begin + static_cast<std::uint32_t>(size));
+
+        std::vector<std::uint8_t*> results;
+        for (const auto& reference : index.From(begin, begin + static_cast<std::uint32_t>(size))) {
+            if (reference.kind == XRefs::Kind::Data)
+                results.push_back(reinterpret_cast<std::uint8_t*>(module) + reference.target);
+        }
+        return results;
+    }
+
+    std::uint8_t* PatternScan(void* module, Scanner::Pattern pattern, Scanner::Region region)
+    {
+        auto rva = PE::PatternScan(GetModule(module), pattern, region);
+        if (rva != Scanner::npos) {
+            return reinterpret_cast<std::uint8_t*>(module) + rva;
         }
 
         return nullptr;
     }
 
+    std::uint8_t* PatternScan(void* module, const char* signature, Scanner::Region region)
+    {
+        return PatternScan(module, Scanner::Parse(signature), region);
+    }
+
+    std::vector<std::uint8_t*> PatternScanBatch(void* module, Scanner::Batch& batch, Scanner::WorkerPool* pool = nullptr)
+    {
+        PE::PatternScanBatch(GetModule(module), batch, pool);
+
+        std::vector<std::uint8_t*> results(batch.Count(), nullptr);
+        for (std::size_t i = 0; i < batch.Count(); ++i) {
+            if (auto rva = batch.First(i); rva != Scanner::npos)
+                results[i] = reinterpret_cast<std::uint8_t*>(module) + rva;
+        }
+
+        return results;
+    }
+
+    std::vector<std::uint8_t*> PatternScanBatch(void* module, const std::vector<const char*>& signatures)
+    {
+        auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
+
+        std::vector<Scanner::ParsedPattern> patterns(signatures.size());
+        Scanner::Batch batch;
+        for (std::size_t i = 0; i < signatures.size(); ++i) {
+            patterns[i] = Scanner::Parse(signatures[i]);
+            batch.Add(patterns[i]);
+        }
+        batch.Run(FlatImage(module));
+
+        std::vector<std::uint8_t*> results(signatures.size(), nullptr);
+        for (std::size_t i = 0; i < signatures.size(); ++i) {
+            if (auto offset = batch.First(i); offset != Scanner::npos)
+                results[i] = &scanBytes[offset];
+        }
+
+        return results;
+    }
+
     std::uint8_t* MultiPatternScan(void* module, const std::vector<const char*>& signatures) 
     { 
-        for (const auto& signature : signatures) 
+        for (auto result : PatternScanBatch(module, signatures)) 
         {
-            std::uint8_t* result = PatternScan(module, signature);
             if (result)
                 return result;
         }
         return nullptr;
     }
 
+    // Matches of a signature over the flat image as addresses, scanned lazily: stop iterating
+    // and the rest of the image is never touched. Nothing is allocated for the results.
+    auto PatternMatches(void* module, const char* signature)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        auto image = FlatImage(module);
+        return Scanner::Matches(image, Scanner::Parse(signature)) | std::views::transform([base](std::size_t offset) { return base + offset; });
+    }
+
+    // Each signature's matches in turn, as MultiPatternScanAll orders them. signatures has to
+    // outlive the range.
+    auto MultiPatternMatches(void* module, const std::vector<const char*>& signatures)
+    {
+        return signatures | std::views::transform([module](const char* signature) { return PatternMatches(module, signature); }) | std::views::join;
+    }
+
+    // The match of a signature that should only occur once. Scanning stops at a second match.
+    struct UniqueMatch
+    {
+        std::uint8_t* address = nullptr;    // First match, even when ambiguous
+        bool ambiguous = false;
+
+        explicit operator bool() const { return address && !ambiguous; }
+    };
+
+    UniqueMatch PatternScanUnique(void* module, const char* signature)
+    {
+        auto match = Scanner::FindUnique(FlatImage(module), Scanner::Parse(signature));
+        if (match.offset == Scanner::npos)
+            return {};
+        return { reinterpret_cast<std::uint8_t*>(module) + match.offset, match.ambiguous };
+    }
+
     std::vector<std::uint8_t*> PatternScanAll(void* module, const char* signature)
     {
-        auto dosHeader = (PIMAGE_DOS_HEADER)module;
-        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
-    
-        auto sizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
-        auto patternBytes = pattern_to_byte(signature);
+        auto pattern = Scanner::Parse(signature);
         auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
     
-        auto s = patternBytes.size();
-        auto d = patternBytes.data();
-    
         std::vector<std::uint8_t*> results;
     
-        for (auto i = 0ul; i < sizeOfImage - s; ++i) {
-            bool found = true;
-            for (auto j = 0ul; j < s; ++j) {
-                if (scanBytes[i + j] != d[j] && d[j] != -1) {
-                    found = false;
-                    break;
-                }
-            }
-            if (found) {
-                results.push_back(&scanBytes[i]);
-            }
-        }
+        Scanner::ForEach(FlatImage(module), pattern, [&](std::size_t offset) {
+            results.push_back(&scanBytes[offset]);
+            return true;
+        });
     
         return results;
     }
 
     std::vector<std::uint8_t*> MultiPatternScanAll(void* module, const std::vector<const char*>& signatures) 
     {
+        auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
+
+        std::vector<Scanner::ParsedPattern> patterns(signatures.size());
+        Scanner::Batch batch;
+        for (std::size_t i = 0; i < signatures.size(); ++i) {
+            patterns[i] = Scanner::Parse(signatures[i]);
+            batch.Add(patterns[i], true);
+        }
+        batch.Run(FlatImage(module));
+
         std::vector<std::uint8_t*> results;
         
-        for (const auto& signature : signatures) 
+        for (std::size_t i = 0; i < signatures.size(); ++i) 
         {
-            auto matches = PatternScanAll(module, signature);
-            results.insert(results.end(), matches.begin(), matches.end());
+            for (auto offset : batch.All(i))
+                results.push_back(&scanBytes[offset]);
         }
 
         return results;
@@ -123,9 +217,7 @@ namespace Memory
 
     std::uint32_t ModuleTimestamp(void* module)
     {
-        auto dosHeader = (PIMAGE_DOS_HEADER)module;
-        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
-        return ntHeaders->FileHeader.TimeDateStamp;
+        return GetModule(module).timestamp;
     }
 
     std::uint8_t* GetAbsolute(std::uint8_t* address) noexcept
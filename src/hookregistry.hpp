@@ -0,0 +1,165 @@
+#pragma once
+
+#include "hudhooks.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Hooks that only do something at some aspect ratios. Each is registered with a predicate over
+// the display state and is taken out of the game's code while the predicate is false, so a
+// native 16:9 player doesn't run a single instruction of it.
+// Toggling a hook suspends the game's threads and changes page protection, so the hook that
+// notices a resize only hands the display over with Request, and a worker thread applies it.
+// Templated on the hook so the tools can drive it with hooks that don't patch anything.
+namespace LightHook
+{
+    class Hook;
+}
+
+template<typename Hook>
+class BasicHookRegistry
+{
+public:
+    BasicHookRegistry() = default;
+
+    // Stop joins the worker. A registry destroyed without it is being torn down by DllMain, where
+    // the worker can't be joined, so it's only let go.
+    ~BasicHookRegistry()
+    {
+        if (worker.joinable())
+            worker.detach();
+    }
+
+    BasicHookRegistry(const BasicHookRegistry&) = delete;
+    BasicHookRegistry& operator=(const BasicHookRegistry&) = delete;
+
+    using Predicate = bool (*)(const HUDHooks::Display& display);
+
+    static bool Wider(const HUDHooks::Display& display) { return display.wider; }
+    static bool Narrower(const HUDHooks::Display& display) { return display.narrower; }
+    static bool NotNative(const HUDHooks::Display& display) { return display.wider || display.narrower; }
+
+    // Hooks start enabled and are only toggled from Update
+    void Add(const char* name, Hook& hook, Predicate active)
+    {
+        if (hook)
+            entries.push_back({ name, &hook, active, true });
+    }
+
+    // Enables or disables every hook whose predicate changed for display. A display in the
+    // same aspect class as the last one applied changes nothing and returns straight away.
+    void Update(const HUDHooks::Display& display)
+    {
+        std::lock_guard lock(updateMutex);
+        auto aspect = Aspect(display);
+        if (aspect == applied)
+            return;
+
+        bool failed = false;
+        for (auto& entry : entries) {
+            bool active = entry.active(display);
+            if (active == entry.enabled)
+                continue;
+
+            if (active ? entry.hook->Enable() : entry.hook->Disable()) {
+                entry.enabled = active;
+                spdlog::info("Hook Registry: {}: {}.", entry.name, active ? "Enabled" : "Bypassed");
+            }
+            else {
+                failed = true;
+                spdlog::error("Hook Registry: {}: Failed to {} hook.", entry.name, active ? "enable" : "disable");
+            }
+        }
+
+        // Left unapplied, and Request forgets it was asked for, so the next display requested
+        // tries the failed toggle again even if it's in the same aspect class
+        if (failed)
+            requested.store(NoAspect, std::memory_order_relaxed);
+        else
+            applied = aspect;
+    }
+
+    // Safe to call from a hook: stores display and wakes the worker, only if the aspect class changed
+    void Request(const HUDHooks::Display& display)
+    {
+        auto aspect = Aspect(display);
+        if (requested.exchange(aspect, std::memory_order_relaxed) == aspect)
+            return;
+
+        {
+            std::lock_guard lock(pendingMutex);
+            pending = display;
+            hasPending = true;
+        }
+        wake.notify_one();
+    }
+
+    // Starts the worker that applies requests. Requests made before this are applied once it runs.
+    void Start()
+    {
+        if (!worker.joinable())
+            worker = std::thread([this] { Run(); });
+    }
+
+    // Stops and joins the worker, requests still pending are dropped
+    void Stop()
+    {
+        {
+            std::lock_guard lock(pendingMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+private:
+    struct Entry
+    {
+        const char* name;
+        Hook* hook;
+        Predicate active;
+        bool enabled;
+    };
+
+    static constexpr std::uint8_t NoAspect = 0xFF;     // Nothing applied or requested yet
+
+    std::vector<Entry> entries;
+    std::mutex updateMutex;
+    std::uint8_t applied = NoAspect;
+
+    std::atomic<std::uint8_t> requested = NoAspect;
+    std::mutex pendingMutex;
+    std::condition_variable wake;
+    HUDHooks::Display pending;
+    bool hasPending = false;
+    bool stopping = false;
+    std::thread worker;
+
+    // Every predicate depends only on this
+    static std::uint8_t Aspect(const HUDHooks::Display& display) { return static_cast<std::uint8_t>(display.wider | display.narrower << 1); }
+
+    void Run()
+    {
+        std::unique_lock lock(pendingMutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || hasPending; });
+            if (stopping)
+                return;
+
+            auto display = pending;
+            hasPending = false;
+            lock.unlock();
+            Update(display);
+            lock.lock();
+        }
+    }
+};
+
+using HookRegistry = BasicHookRegistry<LightHook::Hook>;
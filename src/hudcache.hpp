@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum class HUDObjectCategory : std::uint8_t
+{
+    None,
+    CapturePlane,
+    Map,
+    DamageFrame,
+    PauseMenu,
+    BaseBackground,
+    Fades,
+    MenuLetterboxing,
+    Letterboxing,
+    GradientBackground
+};
+
+// What the HUD Objects hook does to one object at the current resolution
+struct HUDObjectResult
+{
+    HUDObjectCategory category = HUDObjectCategory::None;
+    bool writeSize = false;
+    bool writeOffset = false;
+    std::uintptr_t size = 0;    // Packed (height << 16) | width, returned in rax
+    float offset = 0.00f;       // Written to object + 0x50
+};
+
+// Direct-mapped cache of HUD object results keyed by object pointer and size.
+// Entries from an older epoch count as misses, so bumping the epoch on a resolution change drops everything at once.
+// Callers read Epoch() once before looking at the display and pass it to both Find and Store, so a
+// result computed from the old display can't be stored as valid for the new one.
+class HUDObjectCache
+{
+public:
+    static constexpr std::size_t Bits = 12;
+    static constexpr std::size_t Size = std::size_t(1) << Bits;
+
+    // Pairs with the release in Invalidate, a display published before the bump is visible after this
+    std::uint32_t Epoch() const
+    {
+        return epoch.load(std::memory_order_acquire);
+    }
+
+    const HUDObjectResult* Find(std::uintptr_t object, short x, short y, std::uint32_t current) const
+    {
+        const auto& entry = entries[Index(object)];
+        if (entry.object != object || entry.x != x || entry.y != y || entry.epoch != current)
+            return nullptr;
+        return &entry.result;
+    }
+
+    void Store(std::uintptr_t object, short x, short y, std::uint32_t computed, const HUDObjectResult& result)
+    {
+        entries[Index(object)] = { object, x, y, computed, result };
+    }
+
+    // Call after publishing the new display
+    void Invalidate()
+    {
+        epoch.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    struct Entry
+    {
+        std::uintptr_t object = 0;
+        short x = 0;
+        short y = 0;
+        std::uint32_t epoch = 0;
+        HUDObjectResult result;
+    };
+
+    std::array<Entry, Size> entries{};
+    std::atomic<std::uint32_t> epoch = 1;
+
+    static std::size_t Index(std::uintptr_t object)
+    {
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(object) * 0x9E3779B97F4A7C15ull) >> (64 - Bits));
+    }
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "hudcache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+// Every distinct HUD object the HUD Objects hook sees, by name and size, with how often it was
+// seen. For finding UI elements that still need a rule. The table is allocated up front and
+// filled without locks: a new entry claims its slot with one compare-exchange on the key and
+// publishes its name with a release store, repeat visits are one hash and one relaxed add.
+// Dump writes a CSV snapshot and can run while the hook keeps recording.
+class HUDCensus
+{
+public:
+    static constexpr std::size_t Bits = 12;
+    static constexpr std::size_t Capacity = std::size_t(1) << Bits;
+    static constexpr std::size_t NameSize = 64;     // Longer names are cut, and counted as one
+
+    void Record(const char* name, short x, short y, HUDObjectCategory category)
+    {
+        auto length = strnlen(name, NameSize - 1);
+        auto key = Key(std::string_view(name, length), x, y);
+
+        // Linear probing, a full table drops what doesn't fit
+        for (std::size_t probe = 0, index = key >> (64 - Bits); probe < Capacity; ++probe, index = (index + 1) & (Capacity - 1)) {
+            auto& entry = entries[index];
+            auto current = entry.key.load(std::memory_order_acquire);
+            if (current == 0 && entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                std::memcpy(entry.name, name, length);
+                entry.name[length] = '\0';
+                entry.x = x;
+                entry.y = y;
+                entry.category = category;
+                entry.hits.fetch_add(1, std::memory_order_relaxed);
+                entry.ready.store(true, std::memory_order_release);
+                return;
+            }
+            if (current == key) {
+                entry.hits.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Writes every entry recorded so far, most seen first
+    bool Dump(const std::filesystem::path& path) const
+    {
+        struct Row
+        {
+            const Entry* entry;
+            std::uint64_t hits;
+        };
+
+        std::vector<Row> rows;
+        for (const auto& entry : entries) {
+            if (entry.ready.load(std::memory_order_acquire))
+                rows.push_back({ &entry, entry.hits.load(std::memory_order_relaxed) });
+        }
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.hits > b.hits; });
+
+        auto temp = path;
+        temp += ".tmp";
+        {
+            std::ofstream file(temp, std::ios::trunc);
+            if (!file)
+                return false;
+
+            file << "name,width,height,category,hits\n";
+            for (const auto& [entry, hits] : rows) {
+                file << '"';
+                for (auto c = entry->name; *c; ++c)
+                    file << (*c == '"' ? "\"\"" : std::string_view(c, 1));
+                file << "\"," << entry->x << ',' << entry->y << ',' << CategoryName(entry->category) << ',' << hits << '\n';
+            }
+
+            if (!file)
+                return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temp, path, error);
+        return !error;
+    }
+
+    std::size_t Count() const
+    {
+        return static_cast<std::size_t>(std::count_if(entries.begin(), entries.end(), [](const Entry& entry) { return entry.ready.load(std::memory_order_relaxed); }));
+    }
+
+    std::uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    static const char* CategoryName(HUDObjectCategory category)
+    {
+        switch (category) {
+        case HUDObjectCategory::CapturePlane: return "Capture Plane";
+        case HUDObjectCategory::Map: return "Map";
+        case HUDObjectCategory::DamageFrame: return "Damage Frame";
+        case HUDObjectCategory::PauseMenu: return "Pause Menu";
+        case HUDObjectCategory::BaseBackground: return "Base BG";
+        case HUDObjectCategory::Fades: return "Fades";
+        case HUDObjectCategory::MenuLetterboxing: return "Menu Letterboxing";
+        case HUDObjectCategory::Letterboxing: return "Letterboxing";
+        case HUDObjectCategory::GradientBackground: return "Gradient Background";
+        default: return "None";
+        }
+    }
+
+private:
+    struct Entry
+    {
+        std::atomic<std::uint64_t> key = 0;     // 0 while the slot is free
+        std::atomic<std::uint64_t> hits = 0;
+        std::atomic<bool> ready = false;        // Name and size are written
+        HUDObjectCategory category = HUDObjectCategory::None;
+        short x = 0;
+        short y = 0;
+        char name[NameSize]{};
+    };
+
+    std::array<Entry, Capacity> entries{};
+    std::atomic<std::uint64_t> dropped = 0;
+
+    // Multiply-rotate over the name eight bytes at a time, then the size. Never 0.
+    static std::uint64_t Key(std::string_view name, short x, short y)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325ull ^ name.size();
+        auto mix = [&](std::uint64_t value) {
+            hash = std::rotl((hash ^ value) * 0x9E3779B97F4A7C15ull, 29);
+        };
+
+        std::size_t i = 0;
+        for (; i + 8 <= name.size(); i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, name.data() + i, sizeof(word));
+            mix(word);
+        }
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, name.data() + i, name.size() - i);
+        mix(tail);
+        mix(static_cast<std::uint64_t>(static_cast<std::uint16_t>(x)) << 16 | static_cast<std::uint16_t>(y));
+
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+        return hash | (hash == 0);
+    }
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "hudcache.hpp"
+#include "hudcensus.hpp"
+#include "hudrules.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+// HUD hook bodies as plain functions over a register context, so they can be driven
+// outside the game. Context is SafetyHookContext in the fix and anything with the same
+// xmm0-xmm7, rax and r12 members elsewhere.
+namespace HUDHooks
+{
+    inline constexpr float NativeAspect = 1.7777778f;
+
+    // Everything the hooks derive from the current resolution, computed once per resize so
+    // hook bodies only load. Defaults leave every hook a no-op until a resolution is known.
+    struct Display
+    {
+        int resX = 0;
+        int resY = 0;
+        float aspectRatio = 0.00f;
+        float aspectMultiplier = 0.00f;
+        float hudWidth = 0.00f;
+        float hudHeight = 0.00f;
+        float hudWidthOffset = 0.00f;
+        float hudHeightOffset = 0.00f;
+        float hudSizeX = 1920.00f;          // HUD canvas written by the HUD Size hook
+        float hudSizeY = 1080.00f;
+        float healthBarsOffsetX = 0.00f;    // Added by Health Bars 2
+        float healthBarsOffsetY = 0.00f;
+        bool wider = false;                 // Than native 16:9
+        bool narrower = false;
+
+        void Calculate(int x, int y)
+        {
+            resX = x;
+            resY = y;
+            aspectRatio = (float)resX / (float)resY;
+            aspectMultiplier = aspectRatio / NativeAspect;
+            wider = aspectRatio > NativeAspect;
+            narrower = aspectRatio < NativeAspect;
+
+            hudWidth = (float)resY * NativeAspect;
+            hudHeight = (float)resY;
+            hudWidthOffset = (float)(resX - hudWidth) / 2.00f;
+            hudHeightOffset = 0.00f;
+            if (narrower) {
+                hudWidth = (float)resX;
+                hudHeight = (float)resX / NativeAspect;
+                hudWidthOffset = 0.00f;
+                hudHeightOffset = (float)(resY - hudHeight) / 2.00f;
+            }
+
+            hudSizeX = wider ? 1080.00f * aspectRatio : 1920.00f;
+            hudSizeY = narrower ? 1920.00f / aspectRatio : 1080.00f;
+            healthBarsOffsetX = (hudSizeX - 1920.00f) / 2.00f;
+            healthBarsOffsetY = (hudSizeY - 1080.00f) / 2.00f;
+        }
+    };
+
+    // What the HUD Objects hook keeps between calls
+    struct Objects
+    {
+        HUDObjectCache results;
+        HUDRules::Matcher matcher{ HUDRules::Table };
+        std::uint8_t* capturePlane = nullptr;
+        HUDCensus* census = nullptr;    // Records every object seen when set
+
+        // Drops every cached result, for when the aspect ratio changes
+        void Invalidate() { results.Invalidate(); }
+    };
+
+    // Layout of the HUD object record the game passes in r12
+    namespace Object
+    {
+        inline constexpr std::size_t Offset = 0x50;    // float, horizontal offset
+        inline constexpr std::size_t Width = 0x60;     // short
+        inline constexpr std::size_t Height = 0x62;    // short
+    }
+
+    inline HUDObjectResult Classify(Objects& objects, const Display& display, std::uintptr_t object, short x, short y)
+    {
+        HUDObjectResult result;
+
+        std::string_view name = reinterpret_cast<const char*>(object);
+        for (auto matched = objects.matcher.Match(name); matched; matched &= matched - 1) {
+            const auto& rule = objects.matcher[std::countr_zero(matched)];
+            if (!rule.size.Contains(x, y))
+                continue;
+
+            if (rule.category == HUDObjectCategory::CapturePlane) {
+                // Grab capture plane for movies, luckily it's always the first one
+                if (!objects.capturePlane)
+                    objects.capturePlane = (std::uint8_t*)object;
+                if ((std::uint8_t*)object == objects.capturePlane)
+                    continue;
+            }
+
+            HUDRules::Apply(rule, x, y, display.aspectRatio, display.aspectMultiplier, NativeAspect, result);
+        }
+
+        return result;
+    }
+
+    // State is whatever the display is published through, SeqLock<Display> in the fix. It is
+    // only loaded on a cache miss, after the epoch the result is stored under has been read.
+    template<typename Context, typename State>
+    void HUDObjects(Context& ctx, Objects& objects, const State& state)
+    {
+        if (!ctx.r12)
+            return;
+
+        short x = *reinterpret_cast<short*>(ctx.r12 + Object::Width);
+        short y = *reinterpret_cast<short*>(ctx.r12 + Object::Height);
+
+        // Repeat visits to the same object at the same resolution are a single lookup
+        auto epoch = objects.results.Epoch();
+        auto result = objects.results.Find(ctx.r12, x, y, epoch);
+        HUDObjectResult classified;
+        if (!result) {
+            classified = Classify(objects, state.Load(), ctx.r12, x, y);
+            objects.results.Store(ctx.r12, x, y, epoch, classified);
+            result = &classified;
+        }
+
+        if (objects.census)
+            objects.census->Record(reinterpret_cast<const char*>(ctx.r12), x, y, result->category);
+
+        if (result->writeSize)
+            ctx.rax = result->size;
+        if (result->writeOffset)
+            *reinterpret_cast<float*>(ctx.r12 + Object::Offset) = result->offset;
+    }
+
+    template<typename Context>
+    void HealthBars1(Context& ctx, const Display& display)
+    {
+        if (display.wider)
+            ctx.xmm6.f32[0] = 1920.00f;
+        else if (display.narrower)
+            ctx.xmm5.f32[0] = 1080.00f;
+    }
+
+    template<typename Context>
+    void HealthBars2(Context& ctx, const Display& display)
+    {
+        if (display.wider)
+            ctx.xmm3.f32[0] += display.healthBarsOffsetX;
+        else if (display.narrower)
+            ctx.xmm4.f32[0] += display.healthBarsOffsetY;
+    }
+
+    template<typename Context>
+    void FloatingMarkersHorizontal(Context& ctx, const Display& display)
+    {
+        if (display.wider)
+            ctx.xmm0.f32[0] += display.hudWidthOffset;
+    }
+
+    template<typename Context>
+    void FloatingMarkersVertical(Context& ctx, const Display& display)
+    {
+        if (display.narrower)
+            ctx.xmm0.f32[0] += display.hudHeightOffset;
+    }
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "hudcache.hpp"
+
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// HUD object rules as data: a name substring, the sizes it applies to and how to rescale it.
+// All substrings are compiled into one Aho-Corasick automaton, so matching a name costs one
+// pass over it no matter how many rules there are.
+namespace HUDRules
+{
+    // Inclusive bounds on the object size read from 0x60/0x62
+    struct Size
+    {
+        short minX = SHRT_MIN;
+        short maxX = SHRT_MAX;
+        short minY = SHRT_MIN;
+        short maxY = SHRT_MAX;
+
+        constexpr bool Contains(short x, short y) const { return x >= minX && x <= maxX && y >= minY && y <= maxY; }
+    };
+
+    inline constexpr Size AnySize = {};
+    constexpr Size Exact(short x, short y) { return { x, x, y, y }; }
+    constexpr Size Width(short x) { return { x, x, SHRT_MIN, SHRT_MAX }; }
+    constexpr Size AtLeast(short x, short y = SHRT_MIN) { return { x, SHRT_MAX, y, SHRT_MAX }; }
+
+    // What a rule writes when the aspect ratio is wider or narrower than native
+    enum class Scale : std::uint8_t
+    {
+        None,           // Classify only
+        Stretch,        // Wider: width * aspect multiplier
+        Fill,           // Stretch, narrower: height = width / aspect ratio
+        Capture,        // Wider: width = height * aspect ratio, narrower: height = width / aspect ratio
+        Anchor,         // Wider: width = base * aspect ratio
+        AnchorFill,     // Anchor, narrower: height = width / aspect ratio
+        DamageLeft,     // Anchor and shift the object left by the new width
+        DamageRight     // Anchor and shift the object right by the new width
+    };
+
+    struct Rule
+    {
+        const char* name;
+        const char* pattern;
+        HUDObjectCategory category;
+        Size size;
+        Scale scale;
+        float base = 0.00f;
+    };
+
+    // Matching rules are applied in table order, so a later rule overrides an earlier one.
+    // The left damage frame comes last so it wins over the right one, as it always has.
+    inline constexpr Rule Table[] = {
+        { "Capture Plane", "capture_plane_full_rgba8", HUDObjectCategory::CapturePlane, AnySize, Scale::Capture },
+        { "Map", "bg_strategy_book", HUDObjectCategory::Map, Exact(1920, 1080), Scale::Stretch },
+        { "Map", "PIC_gra", HUDObjectCategory::Map, Exact(1920, 108), Scale::Stretch },
+        { "Map", "parts_book_top_frame_01", HUDObjectCategory::Map, Exact(1920, 1080), Scale::Stretch },
+        { "Map", "parts_book_top_frame_02", HUDObjectCategory::Map, AnySize, Scale::Stretch },
+        { "Damage Frame", "PIC_bg_frame_damage_", HUDObjectCategory::DamageFrame, AnySize, Scale::None },
+        { "Damage Frame", "PIC_bg_frame_damage_r", HUDObjectCategory::DamageFrame, AnySize, Scale::DamageRight, 540.00f },
+        { "Damage Frame", "PIC_bg_frame_damage_l", HUDObjectCategory::DamageFrame, AnySize, Scale::DamageLeft, 540.00f },
+        { "Pause Menu", "PIC_common_square_bl", HUDObjectCategory::PauseMenu, AnySize, Scale::Stretch },
+        { "Pause Menu", "PIC_parts_header_bg_tab", HUDObjectCategory::PauseMenu, AnySize, Scale::Stretch },
+        { "Base BG", "WIN_base_system_bg", HUDObjectCategory::BaseBackground, Width(2600), Scale::AnchorFill, 1463.00f },
+        { "Fades", "PIC_bg_rect_window", HUDObjectCategory::Fades, AtLeast(1920, 1080), Scale::Fill },
+        { "Fades", "PIC_mask_bg", HUDObjectCategory::Fades, AtLeast(1920, 1080), Scale::Fill },
+        { "Fades", "PIC_square_w", HUDObjectCategory::Fades, AtLeast(1920, 1080), Scale::Fill },
+        { "Fades", "PIC_black", HUDObjectCategory::Fades, AtLeast(1920, 1080), Scale::Fill },
+        { "Menu Letterboxing", "PIC_square_w", HUDObjectCategory::MenuLetterboxing, Width(1920), Scale::Stretch },
+        { "Letterboxing", "letterbox", HUDObjectCategory::Letterboxing, AtLeast(1920), Scale::Stretch },
+        { "Gradient Background", "PIC_bottomGradation", HUDObjectCategory::GradientBackground, Width(2880), Scale::Anchor, 1620.00f },
+    };
+
+    static_assert(std::size(Table) <= 64, "Rule masks are 64 bits wide");
+
+    class Matcher
+    {
+    public:
+        explicit Matcher(std::span<const Rule> rules) : rules(rules)
+        {
+            // Bytes that appear in no pattern share class 0 and always lead back to the root
+            for (const auto& rule : rules) {
+                for (auto c : std::string_view(rule.pattern)) {
+                    auto& cls = classOf[static_cast<std::uint8_t>(c)];
+                    if (!cls)
+                        cls = static_cast<std::uint8_t>(++classes - 1);
+                }
+            }
+
+            // Trie, with missing edges marked as empty
+            constexpr std::uint16_t Empty = 0xFFFF;
+            next.assign(classes, Empty);
+            outputs.assign(1, 0);
+            for (std::size_t i = 0; i < rules.size(); ++i) {
+                std::uint16_t state = 0;
+                for (auto c : std::string_view(rules[i].pattern)) {
+                    auto& edge = next[state * classes + classOf[static_cast<std::uint8_t>(c)]];
+                    if (edge == Empty) {
+                        edge = static_cast<std::uint16_t>(outputs.size());
+                        outputs.push_back(0);
+                        next.resize(next.size() + classes, Empty);
+                    }
+                    state = next[state * classes + classOf[static_cast<std::uint8_t>(c)]];
+                }
+                outputs[state] |= std::uint64_t(1) << i;
+            }
+
+            // Breadth-first failure links, folded into a full transition table
+            std::vector<std::uint16_t> fail(outputs.size(), 0);
+            std::vector<std::uint16_t> queue;
+            for (std::size_t c = 0; c < classes; ++c) {
+                auto& edge = next[c];
+                if (edge == Empty)
+                    edge = 0;
+                else
+                    queue.push_back(edge);
+            }
+
+            for (std::size_t head = 0; head < queue.size(); ++head) {
+                auto state = queue[head];
+                outputs[state] |= outputs[fail[state]];
+                for (std::size_t c = 0; c < classes; ++c) {
+                    auto& edge = next[state * classes + c];
+                    auto fallback = next[fail[state] * classes + c];
+                    if (edge == Empty) {
+                        edge = fallback;
+                    }
+                    else {
+                        fail[edge] = fallback;
+                        queue.push_back(edge);
+                    }
+                }
+            }
+        }
+
+        // Rules whose pattern occurs in name. Sizes are checked by the caller, a table with any
+        // AnySize rule has to look at every name anyway.
+        std::uint64_t Match(std::string_view name) const
+        {
+            std::uint64_t found = 0;
+            std::uint16_t state = 0;
+            for (auto c : name) {
+                state = next[state * classes + classOf[static_cast<std::uint8_t>(c)]];
+                found |= outputs[state];
+            }
+            return found;
+        }
+
+        const Rule& operator[](std::size_t index) const { return rules[index]; }
+
+    private:
+        std::span<const Rule> rules;
+        std::size_t classes = 1;
+        std::array<std::uint8_t, 256> classOf{};
+        std::vector<std::uint16_t> next;
+        std::vector<std::uint64_t> outputs;
+    };
+
+    // Writes what rule does to an object of size x * y into result
+    inline void Apply(const Rule& rule, short x, short y, float aspectRatio, float aspectMultiplier, float nativeAspect, HUDObjectResult& result)
+    {
+        result.category = rule.category;
+
+        if (aspectRatio > nativeAspect) {
+            switch (rule.scale) {
+            case Scale::Stretch:
+            case Scale::Fill:
+                result.size = (static_cast<std::uintptr_t>(y) << 16) | (short)ceilf(x * aspectMultiplier);
+                result.writeSize = true;
+                break;
+            case Scale::Capture:
+                result.size = (static_cast<std::uintptr_t>(y) << 16) | (short)ceilf(y * aspectRatio);
+                result.writeSize = true;
+                break;
+            case Scale::Anchor:
+            case Scale::AnchorFill:
+            case Scale::DamageLeft:
+            case Scale::DamageRight:
+                result.size = (static_cast<std::uintptr_t>(y) << 16) | (short)ceilf(rule.base * aspectRatio);
+                result.writeSize = true;
+                break;
+            default:
+                break;
+            }
+
+            if (rule.scale == Scale::DamageLeft || rule.scale == Scale::DamageRight) {
+                result.offset = rule.scale == Scale::DamageLeft ? -ceilf(rule.base * aspectRatio) : ceilf(rule.base * aspectRatio);
+                result.writeOffset = true;
+            }
+        }
+        else if (aspectRatio < nativeAspect) {
+            if (rule.scale == Scale::Fill || rule.scale == Scale::Capture || rule.scale == Scale::AnchorFill) {
+                result.size = (static_cast<std::uintptr_t>((short)ceilf(x / aspectRatio)) << 16) | x;
+                result.writeSize = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <safetyhook.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// Mid hooks that save less than safetyhook::create_mid. A callback hook declares the
+// registers it reads or writes in a template mask and its stub spills those plus the
+// registers the Windows x64 ABI lets the callback clobber, instead of the whole Context64.
+// An add hook has no callback at all: its stub adds a float slot to xmm registers and
+// jumps back, and the slots are rewritten whenever the values change.
+namespace LightHook
+{
+    // Bits 0-15 are xmm0-xmm15, bits 16-31 are the general purpose registers in encoding order
+    enum Register : std::uint32_t
+    {
+        Xmm0 = 1u << 0, Xmm1 = 1u << 1, Xmm2 = 1u << 2, Xmm3 = 1u << 3,
+        Xmm4 = 1u << 4, Xmm5 = 1u << 5, Xmm6 = 1u << 6, Xmm7 = 1u << 7,
+        Xmm8 = 1u << 8, Xmm9 = 1u << 9, Xmm10 = 1u << 10, Xmm11 = 1u << 11,
+        Xmm12 = 1u << 12, Xmm13 = 1u << 13, Xmm14 = 1u << 14, Xmm15 = 1u << 15,
+        Rax = 1u << 16, Rcx = 1u << 17, Rdx = 1u << 18, Rbx = 1u << 19,
+        Rsi = 1u << 22, Rdi = 1u << 23,
+        R8 = 1u << 24, R9 = 1u << 25, R10 = 1u << 26, R11 = 1u << 27,
+        R12 = 1u << 28, R13 = 1u << 29, R14 = 1u << 30, R15 = 1u << 31
+    };
+
+    // What a called function may change, so the stub always keeps a copy
+    inline constexpr std::uint32_t Volatile = Xmm0 | Xmm1 | Xmm2 | Xmm3 | Xmm4 | Xmm5 | Rax | Rcx | Rdx | R8 | R9 | R10 | R11;
+
+    // Same member names as SafetyHookContext so hook bodies take either. Only the masked
+    // registers hold the values from the hook site, writes to any other are dropped.
+    struct Context
+    {
+        safetyhook::Xmm xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7, xmm8, xmm9, xmm10, xmm11, xmm12, xmm13, xmm14, xmm15;
+        std::uintptr_t rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15;
+    };
+
+    static_assert(sizeof(Context) == 16 * 16 + 16 * 8, "Stubs address registers by encoding number");
+
+    using Callback = void (*)(Context& ctx);
+
+    // Stub machine code and the offsets of the slots filled in once it has been placed
+    namespace Emit
+    {
+        struct Code
+        {
+            std::vector<std::uint8_t> bytes;
+            std::size_t trampoline = 0;         // 8 byte address of the relocated original instructions
+            std::vector<std::size_t> addends;   // 4 byte float slots
+        };
+
+        inline constexpr std::int32_t ShadowSpace = 0x20;
+        inline constexpr std::int32_t Frame = ShadowSpace + sizeof(Context);
+
+        inline void Bytes(Code& code, std::initializer_list<std::uint8_t> bytes) { code.bytes.insert(code.bytes.end(), bytes); }
+
+        template<typename T>
+        void Value(Code& code, T value)
+        {
+            auto offset = code.bytes.size();
+            code.bytes.resize(offset + sizeof(T));
+            std::memcpy(code.bytes.data() + offset, &value, sizeof(T));
+        }
+
+        // [rsp + disp32] operand, reg in the modrm reg field
+        inline void RspOperand(Code& code, int reg, std::int32_t displacement)
+        {
+            Bytes(code, { static_cast<std::uint8_t>(0x84 | ((reg & 7) << 3)), 0x24 });
+            Value(code, displacement);
+        }
+
+        // mov [rsp + disp], r64 / mov r64, [rsp + disp]
+        inline void MovGpr(Code& code, int reg, std::int32_t displacement, bool store)
+        {
+            Bytes(code, { static_cast<std::uint8_t>(0x48 | (reg >= 8 ? 0x04 : 0)), static_cast<std::uint8_t>(store ? 0x89 : 0x8B) });
+            RspOperand(code, reg, displacement);
+        }
+
+        // movups [rsp + disp], xmm / movups xmm, [rsp + disp]
+        inline void MovXmm(Code& code, int reg, std::int32_t displacement, bool store)
+        {
+            if (reg >= 8)
+                Bytes(code, { 0x44 });
+            Bytes(code, { 0x0F, static_cast<std::uint8_t>(store ? 0x11 : 0x10) });
+            RspOperand(code, reg, displacement);
+        }
+
+        // jmp [rip]; dq trampoline
+        inline void JumpBack(Code& code)
+        {
+            Bytes(code, { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 });
+            code.trampoline = code.bytes.size();
+            Value<std::uint64_t>(code, 0);
+        }
+
+        inline void Spill(Code& code, std::uint32_t mask, bool store)
+        {
+            for (int reg = 0; reg < 16; ++reg) {
+                if (mask & (1u << reg))
+                    MovXmm(code, reg, ShadowSpace + reg * 16, store);
+            }
+            for (int reg = 0; reg < 16; ++reg) {
+                if (mask & (1u << (16 + reg)))
+                    MovGpr(code, reg, ShadowSpace + 16 * 16 + reg * 8, store);
+            }
+        }
+
+        // pushfq, align the stack, spill, call callback(ctx), reload, restore, jump back
+        inline Code CallbackStub(std::uint32_t registers, std::uintptr_t callback)
+        {
+            auto mask = registers | Volatile;
+
+            Code code;
+            Bytes(code, { 0x9C });                          // pushfq
+            Bytes(code, { 0x55 });                          // push rbp
+            Bytes(code, { 0x48, 0x89, 0xE5 });              // mov rbp, rsp
+            Bytes(code, { 0x48, 0x83, 0xE4, 0xF0 });        // and rsp, -16
+            Bytes(code, { 0x48, 0x81, 0xEC });              // sub rsp, Frame
+            Value(code, Frame);
+
+            Spill(code, mask, true);
+
+            Bytes(code, { 0x48, 0x8D, 0x4C, 0x24, ShadowSpace });   // lea rcx, [rsp + ShadowSpace]
+            Bytes(code, { 0x48, 0xB8 });                            // mov rax, callback
+            Value<std::uint64_t>(code, callback);
+            Bytes(code, { 0xFF, 0xD0 });                            // call rax
+
+            Spill(code, mask, false);
+
+            Bytes(code, { 0x48, 0x89, 0xEC });              // mov rsp, rbp
+            Bytes(code, { 0x5D });                          // pop rbp
+            Bytes(code, { 0x9D });                          // popfq
+            JumpBack(code);
+            return code;
+        }
+
+        // addss xmmN, [rip + slot] for each register, then jump back. No flags or stack are touched.
+        inline Code AddStub(std::initializer_list<int> registers)
+        {
+            Code code;
+            std::vector<std::size_t> fixups;
+            for (auto reg : registers) {
+                Bytes(code, { 0xF3 });
+                if (reg >= 8)
+                    Bytes(code, { 0x44 });
+                Bytes(code, { 0x0F, 0x58, static_cast<std::uint8_t>(0x05 | ((reg & 7) << 3)) });
+                fixups.push_back(code.bytes.size());
+                Value<std::int32_t>(code, 0);
+            }
+            JumpBack(code);
+            while (code.bytes.size() % alignof(float))
+                Bytes(code, { 0xCC });
+
+            // Zeroed slots, so the hook adds nothing until the first value is set
+            for (auto fixup : fixups) {
+                auto slot = code.bytes.size();
+                code.addends.push_back(slot);
+                Value<float>(code, 0.00f);
+
+                auto displacement = static_cast<std::int32_t>(slot - (fixup + sizeof(std::int32_t)));
+                std::memcpy(code.bytes.data() + fixup, &displacement, sizeof(displacement));
+            }
+            return code;
+        }
+    }
+
+    class Hook
+    {
+    public:
+        Hook() = default;
+
+        // Calls callback with the registers in Registers loaded. Rsp and rbp can't be masked.
+        template<std::uint32_t Registers>
+        static Hook Create(std::uint8_t* target, Callback callback)
+        {
+            static_assert((Registers & ((1u << 20) | (1u << 21))) == 0, "rsp and rbp are used by the stub");
+            return Install(target, Emit::CallbackStub(Registers, reinterpret_cast<std::uintptr_t>(callback)));
+        }
+
+        // Adds a float to each xmm register in order. Set the floats with SetAddend.
+        static Hook CreateAdd(std::uint8_t* target, std::initializer_list<int> registers)
+        {
+            return Install(target, Emit::AddStub(registers));
+        }
+
+        void SetAddend(std::size_t index, float value)
+        {
+            if (index < addends.size())
+                std::atomic_ref(*addends[index]).store(value, std::memory_order_relaxed);
+        }
+
+        // Puts the original instructions back or the jump to the stub in again, stub and slots are kept
+        bool Enable() { return hook && hook.enable().has_value(); }
+        bool Disable() { return hook && hook.disable().has_value(); }
+
+        explicit operator bool() const { return static_cast<bool>(hook); }
+
+    private:
+        static Hook Install(std::uint8_t* target, const Emit::Code& code)
+        {
+            // Allocations are only 2 byte aligned, the float slots need 4
+            auto allocator = safetyhook::Allocator::global();
+            auto stub = allocator->allocate(code.bytes.size() + alignof(float) - 1);
+            if (!stub)
+                return {};
+            auto entry = stub->data() + (-stub->address() & (alignof(float) - 1));
+            std::memcpy(entry, code.bytes.data(), code.bytes.size());
+
+            // The stub only becomes reachable once it knows where to jump back to
+            auto inlineHook = safetyhook::InlineHook::create(allocator, target, entry, safetyhook::InlineHook::StartDisabled);
+            if (!inlineHook)
+                return {};
+            auto trampoline = reinterpret_cast<std::uint64_t>(inlineHook->trampoline().data());
+            std::memcpy(entry + code.trampoline, &trampoline, sizeof(trampoline));
+
+            Hook hook;
+            for (auto slot : code.addends)
+                hook.addends.push_back(reinterpret_cast<float*>(entry + slot));
+            hook.stub = std::move(*stub);
+            hook.hook = std::move(*inlineHook);
+            if (!hook.hook.enable())
+                return {};
+            return hook;
+        }
+
+        // Declared before the inline hook so the hook is removed before its stub is freed
+        safetyhook::Allocation stub;
+        safetyhook::InlineHook hook;
+        std::vector<float*> addends;
+    };
+}
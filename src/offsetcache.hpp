@@ -0,0 +1,161 @@
+#pragma once
+
+#include "pe.hpp"
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+
+// Hook site offsets remembered between launches.
+// Keyed by the module's TimeDateStamp and a hash of each signature, so a game patch or an
+// edited signature simply misses and falls back to a full scan.
+class OffsetCache
+{
+public:
+    bool Load(const std::filesystem::path& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+
+        std::string line;
+        std::optional<std::uint32_t> timestamp;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty() || line[0] == ';')
+                continue;
+
+            if (line[0] == '[') {
+                std::uint32_t value = 0;
+                auto close = line.find(']');
+                timestamp.reset();
+                if (close != std::string::npos && ParseHex(line.substr(1, close - 1), value))
+                    timestamp = value;
+                continue;
+            }
+
+            auto equals = line.find('=');
+            std::uint64_t hash = 0;
+            std::uint32_t rva = 0;
+            if (!timestamp || equals == std::string::npos || !ParseHex(Trim(line.substr(0, equals)), hash) || !ParseHex(Trim(line.substr(equals + 1)), rva))
+                continue;
+
+            builds[*timestamp][hash] = rva;
+        }
+        return true;
+    }
+
+    bool Save(const std::filesystem::path& path) const
+    {
+        auto temp = path;
+        temp += ".tmp";
+        {
+            std::ofstream file(temp, std::ios::trunc);
+            if (!file)
+                return false;
+
+            file << "; Hook site offsets, keyed by module timestamp and signature hash. Safe to delete.\n";
+            for (const auto& [timestamp, offsets] : builds) {
+                file << "\n[" << ToHex(timestamp) << "]\n";
+                for (const auto& [hash, rva] : offsets)
+                    file << ToHex(hash) << " = " << ToHex(rva) << "\n";
+            }
+
+            if (!file)
+                return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temp, path, error);
+        return !error;
+    }
+
+    std::optional<std::uint32_t> Find(std::uint32_t timestamp, std::uint64_t hash) const
+    {
+        auto build = builds.find(timestamp);
+        if (build == builds.end())
+            return std::nullopt;
+        auto offset = build->second.find(hash);
+        if (offset == build->second.end())
+            return std::nullopt;
+        return offset->second;
+    }
+
+    void Store(std::uint32_t timestamp, std::uint64_t hash, std::uint32_t rva)
+    {
+        builds[timestamp][hash] = rva;
+    }
+
+    void Erase(std::uint32_t timestamp, std::uint64_t hash)
+    {
+        if (auto build = builds.find(timestamp); build != builds.end())
+            build->second.erase(hash);
+    }
+
+    const std::map<std::uint32_t, std::map<std::uint64_t, std::uint32_t>>& Builds() const { return builds; }
+
+    // FNV-1a over the signature bytes, mask and region
+    static std::uint64_t Hash(const Scanner::Pattern& pattern, Scanner::Region region)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325ull;
+        auto mix = [&](std::uint8_t value) {
+            hash ^= value;
+            hash *= 0x100000001B3ull;
+        };
+
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            mix(pattern.bytes[i] & pattern.mask[i]);
+            mix(pattern.mask[i]);
+        }
+        mix(static_cast<std::uint8_t>(region));
+        return hash;
+    }
+
+    // Checks a cached offset by comparing the signature at that address, which costs O(signature length)
+    static bool Validate(const PE::Module& module, std::uint32_t rva, const Scanner::Pattern& pattern, Scanner::Region region)
+    {
+        if (pattern.size() == 0 || static_cast<std::uint64_t>(rva) + pattern.size() > module.sizeOfImage)
+            return false;
+
+        if (region != Scanner::Region::Any) {
+            bool inRegion = false;
+            for (const auto& section : module.sections) {
+                if (section.In(region) && rva >= section.rva && static_cast<std::uint64_t>(rva) + pattern.size() <= static_cast<std::uint64_t>(section.rva) + section.size)
+                    inRegion = true;
+            }
+            if (!inRegion)
+                return false;
+        }
+
+        return Scanner::Verify(module.base + rva, pattern);
+    }
+
+private:
+    std::map<std::uint32_t, std::map<std::uint64_t, std::uint32_t>> builds;
+
+    static std::string Trim(const std::string& value)
+    {
+        auto first = value.find_first_not_of(" \t");
+        auto last = value.find_last_not_of(" \t");
+        return first == std::string::npos ? std::string{} : value.substr(first, last - first + 1);
+    }
+
+    template<typename T>
+    static bool ParseHex(const std::string& text, T& value)
+    {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+        return result.ec == std::errc{} && result.ptr == text.data() + text.size() && !text.empty();
+    }
+
+    template<typename T>
+    static std::string ToHex(T value)
+    {
+        char buffer[20];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, 16);
+        return std::string(buffer, result.ptr);
+    }
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "scanner.hpp"
+
+#include <algorithm>
+#include <span>
+#include <string>
+
+namespace PE
+{
+    // Section characteristics
+    inline constexpr std::uint32_t SectionCode = 0x00000020;
+    inline constexpr std::uint32_t SectionInitializedData = 0x00000040;
+    inline constexpr std::uint32_t SectionExecute = 0x20000000;
+    inline constexpr std::uint32_t SectionRead = 0x40000000;
+    inline constexpr std::uint32_t SectionWrite = 0x80000000;
+
+    template<typename T>
+    T Read(const std::uint8_t* address)
+    {
+        T value;
+        std::memcpy(&value, address, sizeof(T));
+        return value;
+    }
+
+    struct Section
+    {
+        std::string name;
+        std::uint32_t rva = 0;
+        std::uint32_t size = 0;
+        std::uint32_t rawOffset = 0;
+        std::uint32_t rawSize = 0;
+        std::uint32_t characteristics = 0;
+
+        bool IsCode() const { return (characteristics & (SectionCode | SectionExecute)) != 0; }
+        bool IsData() const { return (characteristics & SectionInitializedData) != 0 && !IsCode(); }
+        bool IsReadable() const { return (characteristics & SectionRead) != 0; }
+        bool IsWritable() const { return (characteristics & SectionWrite) != 0; }
+
+        bool In(Scanner::Region region) const
+        {
+            switch (region) {
+            case Scanner::Region::Code: return IsCode();
+            case Scanner::Region::Data: return IsData();
+            default: return true;
+            }
+        }
+    };
+
+    // Sorted positions of the rarest byte values in a section, built the first time
+    // a single signature is scanned there and reused by every scan after that.
+    struct RareIndex
+    {
+        bool built = false;
+        std::array<std::uint32_t, 256> counts{};
+        std::array<bool, 256> indexed{};
+        std::array<std::uint32_t, 257> start{};
+        std::vector<std::uint32_t> positions;
+    };
+
+    struct Module
+    {
+        const std::uint8_t* base = nullptr;    // Null for a module read from disk
+        std::uint64_t imageBase = 0;            // Preferred load address
+        std::uint32_t sizeOfImage = 0;
+        std::uint32_t sizeOfHeaders = 0;
+        std::uint32_t timestamp = 0;
+        std::vector<Section> sections;
+        mutable std::vector<RareIndex> indices;
+    };
+
+    // Builds a descriptor from the headers of an image that is mapped in memory
+    Module Load(const void* image)
+    {
+        Module module;
+        module.base = static_cast<const std::uint8_t*>(image);
+
+        auto ntHeaders = module.base + Read<std::int32_t>(module.base + 0x3C);
+        auto fileHeader = ntHeaders + 0x4;
+        auto optionalHeader = fileHeader + 0x14;
+
+        auto numberOfSections = Read<std::uint16_t>(fileHeader + 0x2);
+        auto sizeOfOptionalHeader = Read<std::uint16_t>(fileHeader + 0x10);
+        module.timestamp = Read<std::uint32_t>(fileHeader + 0x4);
+        module.imageBase = Read<std::uint16_t>(optionalHeader) == 0x20B ? Read<std::uint64_t>(optionalHeader + 0x18) : Read<std::uint32_t>(optionalHeader + 0x1C);
+        module.sizeOfImage = Read<std::uint32_t>(optionalHeader + 0x38);
+        module.sizeOfHeaders = Read<std::uint32_t>(optionalHeader + 0x3C);
+
+        auto sectionHeader = optionalHeader + sizeOfOptionalHeader;
+        for (std::uint16_t i = 0; i < numberOfSections; ++i, sectionHeader += 0x28) {
+            Section section;
+            auto name = reinterpret_cast<const char*>(sectionHeader);
+            section.name.assign(name, strnlen(name, 8));
+            section.size = Read<std::uint32_t>(sectionHeader + 0x8);
+            section.rva = Read<std::uint32_t>(sectionHeader + 0xC);
+            section.rawSize = Read<std::uint32_t>(sectionHeader + 0x10);
+            section.rawOffset = Read<std::uint32_t>(sectionHeader + 0x14);
+            section.characteristics = Read<std::uint32_t>(sectionHeader + 0x24);
+
+            // Some linkers leave the virtual size empty
+            if (section.size == 0)
+                section.size = section.rawSize;
+
+            // Never read past the mapped image
+            if (section.rva >= module.sizeOfImage)
+                continue;
+            section.size = std::min(section.size, module.sizeOfImage - section.rva);
+
+            module.sections.push_back(std::move(section));
+        }
+
+        std::sort(module.sections.begin(), module.sections.end(), [](const Section& a, const Section& b) { return a.rva < b.rva; });
+        module.indices.resize(module.sections.size());
+        return module;
+    }
+
+    // The whole mapped image
+    std::span<const std::byte> Bytes(const Module& module)
+    {
+        return { reinterpret_cast<const std::byte*>(module.base), module.sizeOfImage };
+    }
+
+    // File offset of the byte the loader maps to rva, npos if no file byte backs it
+    // (past a section's raw data, or between sections)
+    std::size_t RvaToFileOffset(const Module& module, std::uint32_t rva)
+    {
+        if (rva < module.sizeOfHeaders)
+            return rva;
+        for (const auto& section : module.sections) {
+            if (rva >= section.rva && rva - section.rva < std::min(section.size, section.rawSize))
+                return static_cast<std::size_t>(section.rawOffset) + (rva - section.rva);
+        }
+        return Scanner::npos;
+    }
+
+    // Rva the loader maps the byte at a file offset to, npos if it isn't mapped (alignment padding,
+    // overlays). Add it to the module handle for the address an in-process hook would use.
+    std::size_t FileOffsetToRva(const Module& module, std::uint64_t offset)
+    {
+        for (const auto& section : module.sections) {
+            if (offset >= section.rawOffset && offset - section.rawOffset < std::min(section.size, section.rawSize))
+                return section.rva + static_cast<std::size_t>(offset - section.rawOffset);
+        }
+        if (offset < module.sizeOfHeaders)
+            return static_cast<std::size_t>(offset);
+        return Scanner::npos;
+    }
+
+    const RareIndex& BuildIndex(const Module& module, std::size_t sectionIndex)
+    {
+        auto& index = module.indices[sectionIndex];
+        if (index.built)
+            return index;
+
+        const auto& section = module.sections[sectionIndex];
+        const std::uint8_t* data = module.base + section.rva;
+
+        for (std::uint32_t i = 0; i < section.size; ++i)
+            ++index.counts[data[i]];
+
+        // Index the rarest byte values until the position budget is spent
+        std::array<std::uint8_t, 256> order;
+        for (std::size_t b = 0; b < 256; ++b)
+            order[b] = static_cast<std::uint8_t>(b);
+        std::stable_sort(order.begin(), order.end(), [&](std::uint8_t a, std::uint8_t b) { return index.counts[a] < index.counts[b]; });
+
+        std::size_t budget = std::max<std::size_t>(section.size / 256, 4096);
+        for (auto b : order) {
+            if (index.counts[b] > budget)
+                break;
+            index.indexed[b] = true;
+            budget -= index.counts[b];
+        }
+
+        for (std::size_t b = 0; b < 256; ++b)
+            index.start[b + 1] = index.start[b] + (index.indexed[b] ? index.counts[b] : 0);
+
+        index.positions.resize(index.start[256]);
+        std::array<std::uint32_t, 256> fill{};
+        for (std::uint32_t i = 0; i < section.size; ++i) {
+            auto b = data[i];
+            if (index.indexed[b])
+                index.positions[index.start[b] + fill[b]++] = i;
+        }
+
+        index.built = true;
+        return index;
+    }
+
+    // Calls callback(rva) for every match inside the sections of region in ascending order.
+    // Region::Any scans the whole image as one flat buffer, like Memory::PatternScan.
+    template<typename Callback>
+    void ForEach(const Module& module, const Scanner::Pattern& pattern, Scanner::Region region, Callback&& callback)
+    {
+        if (region == Scanner::Region::Any) {
+            Scanner::ForEach(module.base, module.sizeOfImage - 1, pattern, callback);
+            return;
+        }
+
+        for (std::size_t s = 0; s < module.sections.size(); ++s) {
+            const auto& section = module.sections[s];
+            if (!section.In(region) || section.size < pattern.size())
+                continue;
+
+            const std::uint8_t* data = module.base + section.rva;
+            if (!pattern.hasLiteral) {
+                if (!Scanner::ForEach(data, section.size, pattern, [&](std::size_t offset) { return callback(section.rva + offset); }))
+                    return;
+                continue;
+            }
+
+            // Use the least frequent literal byte of this section
+            const auto& index = BuildIndex(module, s);
+            std::size_t best = Scanner::npos;
+            for (std::size_t j = 0; j < pattern.size(); ++j) {
+                if (pattern.mask[j] && (best == Scanner::npos || index.counts[pattern.bytes[j]] < index.counts[pattern.bytes[best]]))
+                    best = j;
+            }
+
+            auto anchorByte = pattern.bytes[best];
+            if (index.counts[anchorByte] == 0)
+                continue;
+
+            if (!index.indexed[anchorByte]) {
+                if (!Scanner::ForEach(data, section.size, pattern, [&](std::size_t offset) { return callback(section.rva + offset); }))
+                    return;
+                continue;
+            }
+
+            for (auto i = index.start[anchorByte]; i < index.start[anchorByte + 1]; ++i) {
+                auto position = index.positions[i];
+                if (position < best)
+                    continue;
+                std::size_t offset = position - best;
+                if (offset + pattern.size() > section.size)
+                    break;
+                if (Scanner::Verify(data + offset, pattern) && !callback(section.rva + offset))
+                    return;
+            }
+        }
+    }
+
+    // Returns the rva of the first match in region
+    std::size_t PatternScan(const Module& module, const Scanner::Pattern& pattern, Scanner::Region region)
+    {
+        std::size_t result = Scanner::npos;
+        ForEach(module, pattern, region, [&](std::size_t rva) {
+            result = rva;
+            return false;
+        });
+        return result;
+    }
+
+    // Runs a batch over the module, walking only the sections each signature's region allows.
+    // With a pool, every range is split into chunks and scanned in parallel. Results are rvas.
+    void PatternScanBatch(const Module& module, Scanner::Batch& batch, Scanner::WorkerPool* pool = nullptr)
+    {
+        batch.Reset();
+
+        auto run = [&](const std::uint8_t* data, std::size_t size, std::size_t rva, const Scanner::Region* region) {
+            if (pool)
+                batch.RunRangeParallel(data, size, rva, region, *pool);
+            else
+                batch.RunRange(data, size, rva, region);
+        };
+
+        const Scanner::Region any = Scanner::Region::Any;
+        run(module.base, module.sizeOfImage - 1, 0, &any);
+
+        for (auto region : { Scanner::Region::Code, Scanner::Region::Data }) {
+            for (const auto& section : module.sections) {
+                if (section.In(region))
+                    run(module.base + section.rva, section.size, section.rva, &region);
+            }
+        }
+    }
+}
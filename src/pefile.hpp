@@ -0,0 +1,245 @@
+#pragma once
+
+#include "pe.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Executables on disk. Both sources read into a caller's buffer through Read(offset, bytes), so
+// the scans below never hold more than one chunk of the file; MappedFile also hands out the
+// whole file as a span for callers that want it flat.
+namespace PE
+{
+    // Plain reads through the stream's own buffer
+    class FileReader
+    {
+    public:
+        bool Open(const std::filesystem::path& path)
+        {
+            file.open(path, std::ios::binary);
+            if (!file)
+                return false;
+            file.seekg(0, std::ios::end);
+            size = static_cast<std::uint64_t>(file.tellg());
+            return static_cast<bool>(file);
+        }
+
+        std::uint64_t Size() const { return size; }
+
+        // Bytes read, short only at the end of the file or on error
+        std::size_t Read(std::uint64_t offset, std::span<std::byte> bytes)
+        {
+            if (offset >= size)
+                return 0;
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(offset));
+            file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(std::min<std::uint64_t>(bytes.size(), size - offset)));
+            return static_cast<std::size_t>(file.gcount());
+        }
+
+    private:
+        std::ifstream file;
+        std::uint64_t size = 0;
+    };
+
+    // Read-only map of the whole file, paged in by the OS as the scan reaches it
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() { Close(); }
+
+        bool Open(const std::filesystem::path& path)
+        {
+            Close();
+#ifdef _WIN32
+            auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER fileSize{};
+            HANDLE mapping = nullptr;
+            if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+                mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (!mapping)
+                return false;
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (!view)
+                return false;
+            size = static_cast<std::uint64_t>(fileSize.QuadPart);
+#else
+            int file = open(path.c_str(), O_RDONLY);
+            if (file < 0)
+                return false;
+            struct stat status{};
+            void* mapped = MAP_FAILED;
+            if (fstat(file, &status) == 0 && status.st_size > 0)
+                mapped = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+            if (mapped == MAP_FAILED)
+                return false;
+            view = mapped;
+            size = static_cast<std::uint64_t>(status.st_size);
+            madvise(view, static_cast<std::size_t>(size), MADV_SEQUENTIAL);
+#endif
+            return true;
+        }
+
+        void Close()
+        {
+            if (!view)
+                return;
+#ifdef _WIN32
+            UnmapViewOfFile(view);
+#else
+            munmap(view, static_cast<std::size_t>(size));
+#endif
+            view = nullptr;
+            size = 0;
+        }
+
+        std::uint64_t Size() const { return size; }
+        std::span<const std::byte> Bytes() const { return { static_cast<const std::byte*>(view), static_cast<std::size_t>(size) }; }
+
+        std::size_t Read(std::uint64_t offset, std::span<std::byte> bytes)
+        {
+            if (offset >= size)
+                return 0;
+            auto count = static_cast<std::size_t>(std::min<std::uint64_t>(bytes.size(), size - offset));
+            std::memcpy(bytes.data(), static_cast<const std::byte*>(view) + offset, count);
+            return count;
+        }
+
+    private:
+        void* view = nullptr;
+        std::uint64_t size = 0;
+    };
+
+    // Parses the headers of an executable on disk. The module has no base, everything else is
+    // as if it had been loaded. Empty if the file isn't a PE image.
+    template<typename Source>
+    std::optional<Module> LoadFile(Source& source)
+    {
+        std::vector<std::byte> headers(std::min<std::uint64_t>(source.Size(), 0x1000));
+        headers.resize(source.Read(0, headers));
+        auto bytes = reinterpret_cast<const std::uint8_t*>(headers.data());
+        if (headers.size() < 0x40 || bytes[0] != 'M' || bytes[1] != 'Z')
+            return std::nullopt;
+
+        auto ntOffset = Read<std::int32_t>(bytes + 0x3C);
+        if (ntOffset < 0 || static_cast<std::size_t>(ntOffset) + 0x18 > headers.size() || std::memcmp(bytes + ntOffset, "PE\0\0", 4) != 0)
+            return std::nullopt;
+
+        // The section table can run past the first page
+        auto fileHeader = bytes + ntOffset + 0x4;
+        std::size_t needed = static_cast<std::size_t>(ntOffset) + 0x18 + Read<std::uint16_t>(fileHeader + 0x10) + Read<std::uint16_t>(fileHeader + 0x2) * 0x28;
+        if (needed > headers.size()) {
+            if (needed > source.Size())
+                return std::nullopt;
+            headers.resize(needed);
+            if (source.Read(0, headers) != needed)
+                return std::nullopt;
+        }
+
+        auto module = Load(headers.data());
+        module.base = nullptr;
+        return module;
+    }
+
+    // Fills bytes with the image from rva on, laid out the way the loader maps it: headers, each
+    // section's raw data at its rva, and zeros for everything the file doesn't back.
+    // False if the file couldn't be read.
+    template<typename Source>
+    bool ReadImage(Source& source, const Module& module, std::uint32_t rva, std::span<std::byte> bytes)
+    {
+        std::size_t filled = 0;
+        while (filled < bytes.size()) {
+            // Length of the run starting at rva that is backed by the file, or by nothing
+            auto run = bytes.size() - filled;
+            auto offset = RvaToFileOffset(module, rva);
+            if (rva < module.sizeOfHeaders)
+                run = std::min<std::size_t>(run, module.sizeOfHeaders - rva);
+            for (const auto& section : module.sections) {
+                if (rva >= section.rva && rva - section.rva < std::min(section.size, section.rawSize))
+                    run = std::min<std::size_t>(run, std::min(section.size, section.rawSize) - (rva - section.rva));
+                else if (section.rva > rva)
+                    run = std::min<std::size_t>(run, section.rva - rva);
+            }
+
+            auto destination = bytes.subspan(filled, run);
+            if (offset == Scanner::npos)
+                std::fill(destination.begin(), destination.end(), std::byte{ 0 });
+            else if (source.Read(offset, destination) != run)
+                return false;
+
+            filled += run;
+            rva += static_cast<std::uint32_t>(run);
+        }
+        return true;
+    }
+
+    // The whole image as the loader would map it, for analysis that needs all of it at once
+    template<typename Source>
+    std::optional<std::vector<std::uint8_t>> ReadImage(Source& source, const Module& module)
+    {
+        std::vector<std::uint8_t> image(module.sizeOfImage);
+        if (!ReadImage(source, module, 0, std::as_writable_bytes(std::span(image))))
+            return std::nullopt;
+        return image;
+    }
+
+    // Feeds [begin, end) of the image to a stream, read with ReadImage a chunk at a time.
+    // Stops early once the stream has nothing left to find. False if the file couldn't be read.
+    template<typename Source>
+    bool StreamImage(Source& source, const Module& module, std::uint32_t begin, std::uint32_t end, Scanner::Stream& stream)
+    {
+        for (std::uint32_t rva = begin; rva < end && !stream.Finished();) {
+            auto chunk = stream.Next();
+            auto count = static_cast<std::uint32_t>(std::min<std::size_t>(chunk.size(), end - rva));
+            if (!ReadImage(source, module, rva, chunk.first(count)))
+                return false;
+            stream.Commit(count);
+            rva += count;
+        }
+        stream.Finish();
+        return true;
+    }
+
+    // PatternScanBatch for an executable on disk: the same walks over the same ranges, streamed
+    // from the file a chunk at a time. Results are rvas and match a scan of the loaded module
+    // wherever the loader leaves the bytes alone, which is all of the code sections bar relocations.
+    template<typename Source>
+    bool PatternScanBatch(Source& source, const Module& module, Scanner::Batch& batch, std::size_t chunkSize = Scanner::Stream::DefaultChunkSize)
+    {
+        batch.Reset();
+
+        const Scanner::Region any = Scanner::Region::Any;
+        Scanner::Stream flat(batch, 0, &any, chunkSize);
+        if (!StreamImage(source, module, 0, module.sizeOfImage - 1, flat))
+            return false;
+
+        for (auto region : { Scanner::Region::Code, Scanner::Region::Data }) {
+            for (const auto& section : module.sections) {
+                if (!section.In(region) || batch.Finished(&region))
+                    continue;
+                Scanner::Stream stream(batch, section.rva, &region, chunkSize);
+                if (!StreamImage(source, module, section.rva, section.rva + section.size, stream))
+                    return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "alloctrack.hpp"
+
+// Per-hook call counts and latency histograms, built with `xmake f --profiling=y` and
+// switched on with [Profiling] in the ini. Each thread records into its own block with plain
+// relaxed stores, and a background thread sums the blocks and logs a summary every interval,
+// and once more when Stop joins it.
+// With profiling off, HOOK_PROFILE expands to nothing.
+#ifdef HOOK_PROFILING
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace Profiler
+{
+    inline constexpr std::size_t MaxHooks = 32;
+    inline constexpr std::size_t Buckets = 48;
+
+    // Bucket b holds calls that took [2^(b-1), 2^b) cycles
+    struct HookStats
+    {
+        std::atomic<std::uint64_t> calls = 0;
+        std::atomic<std::uint64_t> cycles = 0;
+        std::array<std::atomic<std::uint64_t>, Buckets> histogram{};
+    };
+
+    struct ThreadStats
+    {
+        std::array<HookStats, MaxHooks> hooks;
+        ThreadStats* next = nullptr;
+    };
+
+    inline std::atomic<bool> Enabled = false;
+    inline std::array<const char*, MaxHooks> Names{};
+    inline std::atomic<std::size_t> HookCount = 0;
+    inline std::atomic<ThreadStats*> Threads = nullptr;
+    inline thread_local ThreadStats* Local = nullptr;
+
+    inline std::size_t Register(const char* name)
+    {
+        auto id = std::min(HookCount.fetch_add(1), MaxHooks - 1);
+        Names[id] = name;
+        return id;
+    }
+
+    // Blocks are never freed, so the flush thread can always walk the list
+    inline ThreadStats& LocalStats()
+    {
+        if (!Local) {
+            Local = new ThreadStats;
+            Local->next = Threads.load(std::memory_order_relaxed);
+            while (!Threads.compare_exchange_weak(Local->next, Local, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+        return *Local;
+    }
+
+    // Only the owning thread writes a block, so a load and a store is enough
+    inline void Add(std::atomic<std::uint64_t>& counter, std::uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope(std::size_t id) : id(id), start(Enabled.load(std::memory_order_relaxed) ? __rdtsc() : 0) {}
+
+        ~Scope()
+        {
+            if (!start)
+                return;
+
+            auto elapsed = __rdtsc() - start;
+            auto& stats = LocalStats().hooks[id];
+            Add(stats.calls, 1);
+            Add(stats.cycles, elapsed);
+            Add(stats.histogram[std::min<std::size_t>(std::bit_width(elapsed), Buckets - 1)], 1);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::size_t id;
+        std::uint64_t start;
+    };
+
+    struct Totals
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t cycles = 0;
+        std::array<std::uint64_t, Buckets> histogram{};
+    };
+
+    inline std::array<Totals, MaxHooks> Collect()
+    {
+        std::array<Totals, MaxHooks> totals{};
+        for (auto thread = Threads.load(std::memory_order_acquire); thread; thread = thread->next) {
+            for (std::size_t id = 0; id < MaxHooks; ++id) {
+                const auto& stats = thread->hooks[id];
+                totals[id].calls += stats.calls.load(std::memory_order_relaxed);
+                totals[id].cycles += stats.cycles.load(std::memory_order_relaxed);
+                for (std::size_t b = 0; b < Buckets; ++b)
+                    totals[id].histogram[b] += stats.histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+        return totals;
+    }
+
+    // Upper bound in cycles of the bucket holding the given fraction of calls
+    inline std::uint64_t Percentile(const std::array<std::uint64_t, Buckets>& histogram, std::uint64_t calls, double fraction)
+    {
+        auto target = std::min(static_cast<std::uint64_t>(calls * fraction), calls - 1);
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < Buckets; ++b) {
+            seen += histogram[b];
+            if (seen > target)
+                return std::uint64_t(1) << b;
+        }
+        return std::uint64_t(1) << (Buckets - 1);
+    }
+
+    // Logs what happened since the previous flush
+    inline void Flush(std::array<Totals, MaxHooks>& previous)
+    {
+        auto current = Collect();
+        auto count = std::min(HookCount.load(), MaxHooks);
+        for (std::size_t id = 0; id < count; ++id) {
+            Totals delta;
+            delta.calls = current[id].calls - previous[id].calls;
+            delta.cycles = current[id].cycles - previous[id].cycles;
+            for (std::size_t b = 0; b < Buckets; ++b)
+                delta.histogram[b] = current[id].histogram[b] - previous[id].histogram[b];
+
+            if (!delta.calls)
+                continue;
+
+            spdlog::info("Profiling: {}: {} calls, mean {} cycles, p50 < {}, p99 < {}, max < {}", Names[id], delta.calls, delta.cycles / delta.calls,
+                Percentile(delta.histogram, delta.calls, 0.50), Percentile(delta.histogram, delta.calls, 0.99), Percentile(delta.histogram, delta.calls, 1.00));
+        }
+        previous = current;
+    }
+
+    inline std::mutex StopMutex;
+    inline std::condition_variable StopVar;
+    inline bool Stopping = false;
+    inline std::thread FlushThread;
+
+    inline void Start(int intervalSeconds)
+    {
+        Enabled = true;
+        FlushThread = std::thread([intervalSeconds] {
+            std::array<Totals, MaxHooks> previous{};
+            std::unique_lock lock(StopMutex);
+            while (!StopVar.wait_for(lock, std::chrono::seconds(std::max(intervalSeconds, 1)), [] { return Stopping; })) {
+                lock.unlock();
+                Flush(previous);
+                lock.lock();
+            }
+            lock.unlock();
+            Flush(previous);
+        });
+    }
+
+    // Joins the flush thread after it logs what happened since its last summary
+    inline void Stop()
+    {
+        if (!FlushThread.joinable())
+            return;
+
+        {
+            std::lock_guard lock(StopMutex);
+            Stopping = true;
+        }
+        StopVar.notify_all();
+        FlushThread.join();
+    }
+}
+
+#define HOOK_PROFILE(name) \
+    static const std::size_t hookProfileId = Profiler::Register(name); \
+    Profiler::Scope hookProfileScope(hookProfileId)
+
+#else
+
+#define HOOK_PROFILE(name)
+
+#endif
+
+// Instrumentation every hook body starts with. The profiling scope comes first so its one-off
+// per-thread setup isn't counted as an allocation made by the hook.
+#define HOOK_SCOPE(name) \
+    HOOK_PROFILE(name); \
+    HOOK_ALLOC_SCOPE(name)
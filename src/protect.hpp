@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdio>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Page protection changes batched per session, so hooks that write the same few
+// addresses every frame make their protection syscalls once instead of on every write.
+namespace Protect
+{
+    // What makeWritable reports for a page that was writable already and was left alone
+    inline constexpr std::uint32_t Unchanged = 0xFFFFFFFF;
+
+    // How pages are made writable and put back. Swappable so sessions can run against mprotect.
+    // Code pages stay executable, data pages are only ever made read-write.
+    struct Backend
+    {
+        std::size_t (*pageSize)();
+        bool (*makeWritable)(void* page, std::size_t size, std::uint32_t& previous);
+        bool (*restore)(void* page, std::size_t size, std::uint32_t previous);
+    };
+
+#ifdef _WIN32
+    inline const Backend Native = {
+        []() -> std::size_t {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return info.dwPageSize;
+        },
+        [](void* page, std::size_t size, std::uint32_t& previous) {
+            MEMORY_BASIC_INFORMATION info;
+            if (!VirtualQuery(page, &info, sizeof(info)))
+                return false;
+
+            constexpr DWORD Writable = PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+            constexpr DWORD Executable = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+            if ((info.Protect & Writable) && !(info.Protect & PAGE_GUARD)) {
+                previous = Unchanged;
+                return true;
+            }
+
+            DWORD oldProtect;
+            if (!VirtualProtect(page, size, (info.Protect & Executable) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE, &oldProtect))
+                return false;
+            previous = oldProtect;
+            return true;
+        },
+        [](void* page, std::size_t size, std::uint32_t previous) {
+            DWORD oldProtect;
+            return VirtualProtect(page, size, previous, &oldProtect) != 0;
+        }
+    };
+#else
+    // mprotect can't report the old protection, so it's read from /proc/self/maps
+    inline std::uint32_t QueryProtection(const void* address)
+    {
+        std::uint32_t protection = PROT_READ;
+        auto target = reinterpret_cast<std::uintptr_t>(address);
+        if (auto maps = std::fopen("/proc/self/maps", "r")) {
+            unsigned long long start, end;
+            char perms[5];
+            while (std::fscanf(maps, "%llx-%llx %4s %*[^\n]", &start, &end, perms) == 3) {
+                if (target >= start && target < end) {
+                    protection = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) | (perms[2] == 'x' ? PROT_EXEC : 0);
+                    break;
+                }
+            }
+            std::fclose(maps);
+        }
+        return protection;
+    }
+
+    inline const Backend Native = {
+        []() -> std::size_t {
+            return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        },
+        [](void* page, std::size_t size, std::uint32_t& previous) {
+            previous = QueryProtection(page);
+            if ((previous & PROT_READ) && (previous & PROT_WRITE)) {
+                previous = Unchanged;
+                return true;
+            }
+            return mprotect(page, size, static_cast<int>(previous) | PROT_READ | PROT_WRITE) == 0;
+        },
+        [](void* page, std::size_t size, std::uint32_t previous) {
+            return mprotect(page, size, static_cast<int>(previous)) == 0;
+        }
+    };
+#endif
+
+    // Keeps every page it writes to writable until it's restored or destroyed. A session that
+    // outlives one batch of writes should Restore after it, so pages keep their own protection
+    // while it's idle. Pages are unprotected before they are first read, so a guard or
+    // no-access page never faults on the comparison, and writes that wouldn't change memory
+    // are skipped. Pages that were writable already cost one query and are never changed.
+    class WriteSession
+    {
+    public:
+        explicit WriteSession(const Backend& backend = Native) : backend(backend), pageSize(backend.pageSize()) {}
+        ~WriteSession() { Restore(); }
+
+        WriteSession(const WriteSession&) = delete;
+        WriteSession& operator=(const WriteSession&) = delete;
+
+        // False if a page couldn't be made writable, in which case nothing was written
+        bool WriteBytes(std::uint8_t* address, const void* data, std::size_t size)
+        {
+            if (size == 0)
+                return true;
+            if (!Unprotect(address, size))
+                return false;
+            if (std::memcmp(address, data, size) != 0)
+                std::memcpy(address, data, size);
+            return true;
+        }
+
+        template<typename T>
+        bool Write(std::uint8_t* address, const T& value)
+        {
+            return WriteBytes(address, &value, sizeof(T));
+        }
+
+        // Puts every page back the way it was found
+        void Restore()
+        {
+            for (auto it = pages.rbegin(); it != pages.rend(); ++it) {
+                if (it->previous != Unchanged)
+                    backend.restore(reinterpret_cast<void*>(it->base), pageSize, it->previous);
+            }
+            pages.clear();
+        }
+
+        std::size_t PageCount() const { return pages.size(); }
+
+        // Makes every page under [address, address + size) readable and writable for the rest
+        // of the session. Pages the session already holds cost a lookup.
+        bool Unprotect(const std::uint8_t* address, std::size_t size)
+        {
+            auto first = reinterpret_cast<std::uintptr_t>(address) & ~(pageSize - 1);
+            auto last = (reinterpret_cast<std::uintptr_t>(address) + size - 1) & ~(pageSize - 1);
+            for (auto base = first; base <= last; base += pageSize) {
+                if (std::any_of(pages.begin(), pages.end(), [&](const Page& page) { return page.base == base; }))
+                    continue;
+
+                Page page{ base, 0 };
+                if (!backend.makeWritable(reinterpret_cast<void*>(base), pageSize, page.previous))
+                    return false;
+                pages.push_back(page);
+            }
+            return true;
+        }
+
+    private:
+        struct Page
+        {
+            std::uintptr_t base;
+            std::uint32_t previous;
+        };
+
+        const Backend& backend;
+        std::size_t pageSize;
+        std::vector<Page> pages;
+    };
+
+    // A write session that remembers the original bytes of everything it patches.
+    // Unless committed, every patch is undone when the transaction is destroyed.
+    class Transaction
+    {
+    public:
+        explicit Transaction(const Backend& backend = Native) : session(backend) {}
+        ~Transaction()
+        {
+            if (!committed)
+                Rollback();
+        }
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        bool Patch(std::uint8_t* address, const void* data, std::size_t size)
+        {
+            // Only read the original bytes once their pages are readable
+            if (!session.Unprotect(address, size))
+                return false;
+            journal.push_back({ address, std::vector<std::uint8_t>(address, address + size) });
+            return session.WriteBytes(address, data, size);
+        }
+
+        void Commit() { committed = true; }
+
+        // Restores original bytes, newest patch first
+        void Rollback()
+        {
+            for (auto it = journal.rbegin(); it != journal.rend(); ++it)
+                session.WriteBytes(it->address, it->original.data(), it->original.size());
+            journal.clear();
+        }
+
+    private:
+        struct Undo
+        {
+            std::uint8_t* address;
+            std::vector<std::uint8_t> original;
+        };
+
+        WriteSession session;
+        std::vector<Undo> journal;
+        bool committed = false;
+    };
+}
@@ -0,0 +1,1147 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SCANNER_X86) && !defined(_MSC_VER)
+#define SCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCANNER_TARGET_AVX2
+#endif
+
+namespace Scanner
+{
+    inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Byte values ordered from most to least common in x86-64 code and data.
+    // Anything not listed is treated as rare.
+    inline constexpr std::uint8_t CommonBytes[] = {
+        0x00, 0xFF, 0x48, 0x8B, 0x89, 0xCC, 0x0F, 0x24, 0x44, 0x4C, 0xE8, 0x83, 0x01, 0x8D, 0x85, 0x40,
+        0x74, 0x20, 0x08, 0x10, 0xC0, 0x41, 0x45, 0x49, 0x4D, 0x75, 0xF3, 0xC3, 0x33, 0x02, 0x03, 0x04,
+        0x28, 0x30, 0x38, 0x18, 0xE9, 0xEB, 0x50, 0x58, 0x5C, 0x54, 0xC7, 0x84, 0x80, 0x3B, 0x39, 0x0D,
+        0x11, 0x05, 0x8E, 0x4E, 0x4F, 0x57, 0x56, 0x53, 0x55, 0x5B, 0x5D, 0x5E, 0x5F, 0x60, 0x68, 0x70,
+        0x78, 0x90, 0xC1, 0xC6, 0x0C, 0x14, 0x1C, 0x2C, 0x34, 0x3C, 0x65, 0x66, 0x7C, 0x7F, 0x87, 0x88,
+    };
+
+    // Rank of every byte value, higher means more common
+    inline constexpr std::array<std::uint8_t, 256> ByteRank = [] {
+        std::array<std::uint8_t, 256> rank{};
+        for (std::size_t i = 0; i < std::size(CommonBytes); ++i)
+            rank[CommonBytes[i]] = static_cast<std::uint8_t>(std::size(CommonBytes) - i);
+        return rank;
+    }();
+
+    // Non-owning view of a signature. Scanners only ever see this, so they never allocate or parse.
+    struct Pattern
+    {
+        const std::uint8_t* bytes = nullptr;
+        const std::uint8_t* mask = nullptr; // 0xFF for literal bytes, 0x00 for wildcards
+        std::size_t length = 0;
+        std::size_t anchor = 0;             // Offset of the rarest literal byte
+        std::size_t anchor2 = 0;            // Offset of the next rarest literal byte
+        bool hasLiteral = false;
+
+        constexpr std::size_t size() const { return length; }
+    };
+
+    // Which part of a module a signature can live in
+    enum class Region
+    {
+        Any,
+        Code,
+        Data
+    };
+
+    enum class Engine
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    namespace Detail
+    {
+        constexpr int HexDigit(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            return -1;
+        }
+
+        // Parses "48 8B ?? 05" style text. Returns the byte count, or npos if the text is malformed or
+        // longer than capacity. bytes and mask may be null to only count.
+        constexpr std::size_t ParseInto(const char* text, std::size_t textLength, std::uint8_t* bytes, std::uint8_t* mask, std::size_t capacity)
+        {
+            std::size_t count = 0;
+            std::size_t i = 0;
+            while (i < textLength) {
+                if (text[i] == ' ') {
+                    ++i;
+                    continue;
+                }
+
+                std::uint8_t value = 0, literal = 0;
+                if (text[i] == '?') {
+                    i += (i + 1 < textLength && text[i + 1] == '?') ? 2 : 1;
+                }
+                else {
+                    int high = HexDigit(text[i]);
+                    if (high < 0)
+                        return npos;
+                    value = static_cast<std::uint8_t>(high);
+                    literal = 0xFF;
+                    ++i;
+                    if (i < textLength && HexDigit(text[i]) >= 0)
+                        value = static_cast<std::uint8_t>(value * 16 + HexDigit(text[i++]));
+                }
+
+                // Every token has to end at a space or the end of the text
+                if (i < textLength && text[i] != ' ')
+                    return npos;
+                if (count >= capacity)
+                    return npos;
+
+                if (bytes) {
+                    bytes[count] = value;
+                    mask[count] = literal;
+                }
+                ++count;
+            }
+            return count;
+        }
+
+        // Picks the two rarest literal bytes as candidate filters
+        constexpr void SelectAnchors(const std::uint8_t* bytes, const std::uint8_t* mask, std::size_t length, std::size_t& anchor, std::size_t& anchor2, bool& hasLiteral)
+        {
+            std::size_t best = npos, second = npos;
+            for (std::size_t i = 0; i < length; ++i) {
+                if (!mask[i])
+                    continue;
+                if (best == npos || ByteRank[bytes[i]] < ByteRank[bytes[best]]) {
+                    second = best;
+                    best = i;
+                }
+                else if (second == npos || ByteRank[bytes[i]] < ByteRank[bytes[second]]) {
+                    second = i;
+                }
+            }
+
+            hasLiteral = best != npos;
+            anchor = hasLiteral ? best : 0;
+            anchor2 = second != npos ? second : anchor;
+        }
+    }
+
+    // Signature compiled into fixed-size byte and mask arrays at build time
+    template<std::size_t N>
+    struct CompiledPattern
+    {
+        std::array<std::uint8_t, N> bytes{};
+        std::array<std::uint8_t, N> mask{};
+        std::size_t anchor = 0;
+        std::size_t anchor2 = 0;
+        bool hasLiteral = false;
+
+        constexpr Pattern View() const { return { bytes.data(), mask.data(), N, anchor, anchor2, hasLiteral }; }
+        constexpr operator Pattern() const { return View(); }
+    };
+
+    template<std::size_t N>
+    struct SignatureText
+    {
+        char text[N]{};
+
+        consteval SignatureText(const char (&signature)[N])
+        {
+            for (std::size_t i = 0; i < N; ++i)
+                text[i] = signature[i];
+        }
+    };
+
+    template<SignatureText Text>
+    consteval auto Compile()
+    {
+        constexpr std::size_t textLength = std::size(Text.text) - 1;
+        constexpr std::size_t length = Detail::ParseInto(Text.text, textLength, nullptr, nullptr, npos);
+        static_assert(length != npos, "Malformed signature, expected space separated hex bytes or ?? wildcards");
+        static_assert(length != 0, "Empty signature");
+
+        // Keep the array size valid so only the assertion above is reported
+        constexpr std::size_t storage = (length == npos || length == 0) ? 1 : length;
+        CompiledPattern<storage> pattern;
+        if constexpr (storage == length) {
+            Detail::ParseInto(Text.text, textLength, pattern.bytes.data(), pattern.mask.data(), length);
+            Detail::SelectAnchors(pattern.bytes.data(), pattern.mask.data(), length, pattern.anchor, pattern.anchor2, pattern.hasLiteral);
+        }
+        return pattern;
+    }
+
+    namespace Literals
+    {
+        // "48 8B ?? 05"_sig compiles a signature, malformed hex is a compile error
+        template<SignatureText Text>
+        consteval auto operator""_sig()
+        {
+            return Compile<Text>();
+        }
+    }
+
+    // Signature parsed at runtime into fixed storage, for callers that still pass strings.
+    // Malformed or overlong text gives an empty pattern that never matches.
+    struct ParsedPattern
+    {
+        static constexpr std::size_t MaxLength = 256;
+
+        std::array<std::uint8_t, MaxLength> bytes{};
+        std::array<std::uint8_t, MaxLength> mask{};
+        std::size_t length = 0;
+        std::size_t anchor = 0;
+        std::size_t anchor2 = 0;
+        bool hasLiteral = false;
+
+        std::size_t size() const { return length; }
+        Pattern View() const { return { bytes.data(), mask.data(), length, anchor, anchor2, hasLiteral }; }
+        operator Pattern() const { return View(); }
+    };
+
+    ParsedPattern Parse(const char* signature)
+    {
+        ParsedPattern pattern;
+        auto length = Detail::ParseInto(signature, strlen(signature), pattern.bytes.data(), pattern.mask.data(), ParsedPattern::MaxLength);
+        if (length == npos)
+            return {};
+
+        pattern.length = length;
+        Detail::SelectAnchors(pattern.bytes.data(), pattern.mask.data(), length, pattern.anchor, pattern.anchor2, pattern.hasLiteral);
+        return pattern;
+    }
+
+    bool CpuHasAVX2()
+    {
+#if defined(SCANNER_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX2 also needs the OS to save YMM state
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#elif defined(SCANNER_X86)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    Engine DetectEngine()
+    {
+#if defined(SCANNER_X86)
+        return CpuHasAVX2() ? Engine::AVX2 : Engine::SSE2;
+#else
+        return Engine::Scalar;
+#endif
+    }
+
+    // Active engine, can be overridden for benchmarking and comparison
+    inline Engine ActiveEngine = DetectEngine();
+
+    void SetEngine(Engine engine)
+    {
+#if !defined(SCANNER_X86)
+        engine = Engine::Scalar;
+#endif
+        if (engine == Engine::AVX2 && !CpuHasAVX2())
+            engine = Engine::SSE2;
+        ActiveEngine = engine;
+    }
+
+    const char* EngineName(Engine engine)
+    {
+        switch (engine) {
+        case Engine::AVX2: return "AVX2";
+        case Engine::SSE2: return "SSE2";
+        default: return "Scalar";
+        }
+    }
+
+    namespace Detail
+    {
+        bool VerifyScalar(const std::uint8_t* data, const Pattern& pattern, std::size_t from)
+        {
+            for (std::size_t j = from; j < pattern.size(); ++j) {
+                if ((data[j] ^ pattern.bytes[j]) & pattern.mask[j])
+                    return false;
+            }
+            return true;
+        }
+
+        template<typename Callback>
+        bool ScanScalar(const std::uint8_t* data, std::size_t positions, const Pattern& pattern, std::size_t start, Callback& callback)
+        {
+            if (!pattern.hasLiteral) {
+                for (std::size_t i = start; i < positions; ++i) {
+                    if (!callback(i))
+                        return false;
+                }
+                return true;
+            }
+
+            // Let memchr find the anchor byte, then verify the whole signature
+            const std::uint8_t anchorByte = pattern.bytes[pattern.anchor];
+            const std::uint8_t* anchorBase = data + pattern.anchor;
+            std::size_t i = start;
+            while (i < positions) {
+                auto hit = static_cast<const std::uint8_t*>(std::memchr(anchorBase + i, anchorByte, positions - i));
+                if (!hit)
+                    break;
+                i = static_cast<std::size_t>(hit - anchorBase);
+                if (VerifyScalar(data + i, pattern, 0) && !callback(i))
+                    return false;
+                ++i;
+            }
+            return true;
+        }
+
+#if defined(SCANNER_X86)
+        bool VerifySSE2(const std::uint8_t* data, const Pattern& pattern)
+        {
+            const std::size_t s = pattern.size();
+            std::size_t j = 0;
+            for (; j + 16 <= s; j += 16) {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + j));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.bytes + j));
+                __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.mask + j));
+                __m128i diff = _mm_and_si128(_mm_xor_si128(d, b), m);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+                    return false;
+            }
+            return VerifyScalar(data, pattern, j);
+        }
+
+        template<typename Callback>
+        bool ScanSSE2(const std::uint8_t* data, std::size_t positions, const Pattern& pattern, Callback& callback)
+        {
+            if (!pattern.hasLiteral)
+                return ScanScalar(data, positions, pattern, 0, callback);
+
+            const __m128i first = _mm_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor]));
+            const __m128i second = _mm_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor2]));
+
+            std::size_t i = 0;
+            for (; i + 16 <= positions; i += 16) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + pattern.anchor));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + pattern.anchor2));
+                auto candidates = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, second))));
+                while (candidates) {
+                    std::size_t offset = i + std::countr_zero(candidates);
+                    if (VerifySSE2(data + offset, pattern) && !callback(offset))
+                        return false;
+                    candidates &= candidates - 1;
+                }
+            }
+            return ScanScalar(data, positions, pattern, i, callback);
+        }
+
+        SCANNER_TARGET_AVX2 bool VerifyAVX2(const std::uint8_t* data, const Pattern& pattern)
+        {
+            const std::size_t s = pattern.size();
+            std::size_t j = 0;
+            for (; j + 32 <= s; j += 32) {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + j));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern.bytes + j));
+                __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern.mask + j));
+                __m256i diff = _mm256_and_si256(_mm256_xor_si256(d, b), m);
+                if (static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(diff, _mm256_setzero_si256()))) != 0xFFFFFFFFu)
+                    return false;
+            }
+            return VerifyScalar(data, pattern, j);
+        }
+
+        template<typename Callback>
+        SCANNER_TARGET_AVX2 bool ScanAVX2(const std::uint8_t* data, std::size_t positions, const Pattern& pattern, Callback& callback)
+        {
+            if (!pattern.hasLiteral)
+                return ScanScalar(data, positions, pattern, 0, callback);
+
+            const __m256i first = _mm256_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor]));
+            const __m256i second = _mm256_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor2]));
+
+            std::size_t i = 0;
+            for (; i + 32 <= positions; i += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + pattern.anchor));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + pattern.anchor2));
+                auto candidates = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, second))));
+                while (candidates) {
+                    std::size_t offset = i + std::countr_zero(candidates);
+                    if (VerifyAVX2(data + offset, pattern) && !callback(offset))
+                        return false;
+                    candidates &= candidates - 1;
+                }
+            }
+            return ScanScalar(data, positions, pattern, i, callback);
+        }
+#endif
+    }
+
+    // Calls callback(offset) for every match in ascending order until it returns false.
+    // Returns false if the callback stopped the scan early.
+    template<typename Callback>
+    bool ForEach(const std::uint8_t* data, std::size_t size, const Pattern& pattern, Callback&& callback)
+    {
+        if (pattern.size() == 0 || size < pattern.size())
+            return true;
+
+        // Every offset where the whole signature fits inside the buffer
+        const std::size_t positions = size - pattern.size() + 1;
+
+        switch (ActiveEngine) {
+#if defined(SCANNER_X86)
+        case Engine::AVX2:
+            return Detail::ScanAVX2(data, positions, pattern, callback);
+        case Engine::SSE2:
+            return Detail::ScanSSE2(data, positions, pattern, callback);
+#endif
+        default:
+            return Detail::ScanScalar(data, positions, pattern, 0, callback);
+        }
+    }
+
+    template<typename Callback>
+    bool ForEach(std::span<const std::byte> data, const Pattern& pattern, Callback&& callback)
+    {
+        return ForEach(reinterpret_cast<const std::uint8_t*>(data.data()), data.size(), pattern, callback);
+    }
+
+    std::size_t FindFirst(const std::uint8_t* data, std::size_t size, const Pattern& pattern)
+    {
+        std::size_t result = npos;
+        ForEach(data, size, pattern, [&](std::size_t offset) {
+            result = offset;
+            return false;
+        });
+        return result;
+    }
+
+    std::size_t FindFirst(std::span<const std::byte> data, const Pattern& pattern)
+    {
+        return FindFirst(reinterpret_cast<const std::uint8_t*>(data.data()), data.size(), pattern);
+    }
+
+    std::vector<std::size_t> FindAll(const std::uint8_t* data, std::size_t size, const Pattern& pattern)
+    {
+        std::vector<std::size_t> results;
+        ForEach(data, size, pattern, [&](std::size_t offset) {
+            results.push_back(offset);
+            return true;
+        });
+        return results;
+    }
+
+    std::vector<std::size_t> FindAll(std::span<const std::byte> data, const Pattern& pattern)
+    {
+        return FindAll(reinterpret_cast<const std::uint8_t*>(data.data()), data.size(), pattern);
+    }
+
+    // Matches of one signature in ascending order, found one at a time as the range is walked.
+    // Each step resumes the scan just past the previous match, so a caller that stops early never
+    // scans the rest of the buffer, and nothing is allocated. Storage is Pattern for signatures
+    // that outlive the range, or ParsedPattern to carry a parsed one along.
+    template<typename Storage = Pattern>
+    class MatchRange : public std::ranges::view_interface<MatchRange<Storage>>
+    {
+    public:
+        class Iterator
+        {
+        public:
+            using value_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+
+            std::size_t operator*() const { return offset; }
+            Iterator& operator++()
+            {
+                offset = range->Next(offset + 1);
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            bool operator==(std::default_sentinel_t) const { return offset == npos; }
+
+        private:
+            friend class MatchRange;
+            Iterator(const MatchRange* range, std::size_t offset) : range(range), offset(offset) {}
+
+            const MatchRange* range = nullptr;
+            std::size_t offset = npos;
+        };
+
+        MatchRange() = default;
+        MatchRange(const std::uint8_t* data, std::size_t size, const Storage& pattern) : data(data), size(size), pattern(pattern) {}
+
+        Iterator begin() const { return { this, Next(0) }; }
+        std::default_sentinel_t end() const { return {}; }
+
+    private:
+        std::size_t Next(std::size_t from) const
+        {
+            if (from >= size)
+                return npos;
+            auto offset = FindFirst(data + from, size - from, pattern);
+            return offset == npos ? npos : from + offset;
+        }
+
+        const std::uint8_t* data = nullptr;
+        std::size_t size = 0;
+        Storage pattern{};
+    };
+
+    template<typename Storage>
+    MatchRange<Storage> Matches(const std::uint8_t* data, std::size_t size, const Storage& pattern)
+    {
+        return { data, size, pattern };
+    }
+
+    template<typename Storage>
+    MatchRange<Storage> Matches(std::span<const std::byte> data, const Storage& pattern)
+    {
+        return { reinterpret_cast<const std::uint8_t*>(data.data()), data.size(), pattern };
+    }
+
+    // The first match, and whether another one follows it. The scan stops at the second match.
+    struct UniqueMatch
+    {
+        std::size_t offset = npos;
+        bool ambiguous = false;
+
+        explicit operator bool() const { return offset != npos && !ambiguous; }
+    };
+
+    UniqueMatch FindUnique(const std::uint8_t* data, std::size_t size, const Pattern& pattern)
+    {
+        UniqueMatch result;
+        ForEach(data, size, pattern, [&](std::size_t offset) {
+            if (result.offset != npos) {
+                result.ambiguous = true;
+                return false;
+            }
+            result.offset = offset;
+            return true;
+        });
+        return result;
+    }
+
+    UniqueMatch FindUnique(std::span<const std::byte> data, const Pattern& pattern)
+    {
+        return FindUnique(reinterpret_cast<const std::uint8_t*>(data.data()), data.size(), pattern);
+    }
+
+    bool Verify(const std::uint8_t* data, const Pattern& pattern)
+    {
+        switch (ActiveEngine) {
+#if defined(SCANNER_X86)
+        case Engine::AVX2:
+            return Detail::VerifyAVX2(data, pattern);
+        case Engine::SSE2:
+            return Detail::VerifySSE2(data, pattern);
+#endif
+        default:
+            return Detail::VerifyScalar(data, pattern, 0);
+        }
+    }
+
+    // Small fixed pool of scan threads. The calling thread always takes part in the work.
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(std::size_t threadCount)
+        {
+            for (std::size_t i = 1; i < threadCount; ++i)
+                workers.emplace_back([this] { Work(); });
+        }
+
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        std::size_t Size() const { return workers.size() + 1; }
+
+        // Runs task(i) for every i in [0, count) and returns once all of them have finished
+        void Run(std::size_t count, std::function<void(std::size_t)> task)
+        {
+            if (workers.empty() || count <= 1) {
+                for (std::size_t i = 0; i < count; ++i)
+                    task(i);
+                return;
+            }
+
+            auto job = std::make_shared<Job>();
+            job->task = std::move(task);
+            job->count = count;
+            job->pending = count;
+            {
+                std::lock_guard lock(mutex);
+                current = job;
+            }
+            wake.notify_all();
+
+            Drain(*job);
+
+            std::unique_lock lock(mutex);
+            finished.wait(lock, [&] { return job->pending == 0; });
+            current.reset();
+        }
+
+    private:
+        struct Job
+        {
+            std::function<void(std::size_t)> task;
+            std::size_t count = 0;
+            std::atomic<std::size_t> next = 0;
+            std::atomic<std::size_t> pending = 0;
+        };
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        std::shared_ptr<Job> current;
+        bool stopping = false;
+
+        void Drain(Job& job)
+        {
+            for (auto i = job.next++; i < job.count; i = job.next++) {
+                job.task(i);
+                if (--job.pending == 0) {
+                    std::lock_guard lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+
+        void Work()
+        {
+            std::shared_ptr<Job> last;
+            while (true) {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock lock(mutex);
+                    wake.wait(lock, [&] { return stopping || (current && current != last); });
+                    if (stopping)
+                        return;
+                    job = last = current;
+                }
+                Drain(*job);
+            }
+        }
+    };
+
+    // Scans for many signatures in a single pass over the buffer.
+    // Each signature is filtered on the same two rarest literal bytes the single signature
+    // engines use and owns one of eight bucket bits. The first byte is looked up once per
+    // position for every signature, the second once per distinct distance between the two, so
+    // a position only reaches Dispatch when some signature's pair is there. Up to eight
+    // signatures the filter is exact, past that bucket bits are shared and Dispatch sorts out
+    // the extra candidates.
+    class Batch
+    {
+    public:
+        std::size_t Add(Pattern pattern, bool findAll = false, Region region = Region::Any)
+        {
+            auto lead = std::min(pattern.anchor, pattern.anchor2);
+            auto distance = std::max(pattern.anchor, pattern.anchor2) - lead;
+            entries.push_back({ pattern, lead, distance, findAll, region, false, {} });
+            return entries.size() - 1;
+        }
+
+        std::size_t Count() const { return entries.size(); }
+        const Pattern& Signature(std::size_t id) const { return entries[id].pattern; }
+        Region SignatureRegion(std::size_t id) const { return entries[id].region; }
+        std::size_t First(std::size_t id) const { return entries[id].matches.empty() ? npos : entries[id].matches.front(); }
+        const std::vector<std::size_t>& All(std::size_t id) const { return entries[id].matches; }
+
+        void Reset()
+        {
+            for (auto& entry : entries) {
+                entry.matches.clear();
+                entry.done = false;
+            }
+        }
+
+        void Run(const std::uint8_t* data, std::size_t size)
+        {
+            Reset();
+            RunRange(data, size, 0, nullptr);
+        }
+
+        void Run(std::span<const std::byte> data) { Run(reinterpret_cast<const std::uint8_t*>(data.data()), data.size()); }
+
+        // True once every first-match signature tagged with region has its match, or every one
+        // when region is null. Find-all signatures are never finished.
+        bool Finished(const Region* region = nullptr) const
+        {
+            return std::all_of(entries.begin(), entries.end(), [&](const Entry& entry) { return entry.done || (region && entry.region != *region); });
+        }
+
+        // Bytes a range has to share with the next one so no match of an unfinished signature
+        // tagged with region is split between them
+        std::size_t Overlap(const Region* region) const
+        {
+            std::size_t overlap = 0;
+            for (const auto& entry : entries) {
+                if (!entry.done && (!region || entry.region == *region) && entry.pattern.size() > 0)
+                    overlap = std::max(overlap, entry.pattern.size() - 1);
+            }
+            return overlap;
+        }
+
+        // Scans one range for the signatures tagged with region, or all signatures if region is null.
+        // Matches are recorded as offset + position within the range and only matches starting
+        // before limit are kept. Ranges must be walked in ascending order for the first match
+        // to be the lowest one.
+        void RunRange(const std::uint8_t* data, std::size_t size, std::size_t offset, const Region* region, std::size_t limit = npos)
+        {
+            for (auto& group : groups)
+                group.clear();
+            leadBits.fill(0);
+            follows.clear();
+            unpaired = 0;
+
+            remaining = 0;
+            rangeOffset = offset;
+            rangeLimit = limit;
+            for (std::size_t id = 0; id < entries.size(); ++id) {
+                auto& entry = entries[id];
+                if (entry.done || (region && entry.region != *region) || entry.pattern.size() == 0 || size < entry.pattern.size())
+                    continue;
+
+                // Signatures without literal bytes match at every offset
+                if (!entry.pattern.hasLiteral) {
+                    ForEach(data, size, entry.pattern, [&](std::size_t position) {
+                        if (position >= limit)
+                            return false;
+                        entry.matches.push_back(offset + position);
+                        return entry.findAll;
+                    });
+                    entry.done = !entry.findAll;
+                    continue;
+                }
+
+                auto bit = static_cast<std::uint8_t>(1u << (remaining % groups.size()));
+                groups[remaining % groups.size()].push_back(static_cast<std::uint32_t>(id));
+                leadBits[entry.pattern.bytes[entry.lead]] |= bit;
+                ++remaining;
+
+                // A signature with a single literal byte takes whatever follows it
+                if (entry.distance == 0) {
+                    unpaired |= bit;
+                    continue;
+                }
+                auto follow = std::find_if(follows.begin(), follows.end(), [&](const Follow& follow) { return follow.distance == entry.distance; });
+                if (follow == follows.end())
+                    follow = follows.insert(follows.end(), Follow{ .distance = entry.distance });
+                follow->bits[entry.pattern.bytes[entry.lead + entry.distance]] |= bit;
+            }
+
+            if (remaining == 0)
+                return;
+
+            // One or two signatures are cheaper to walk with the single signature engines
+            if (remaining < SinglePassMinimum) {
+                for (const auto& group : groups) {
+                    for (auto id : group) {
+                        auto& entry = entries[id];
+                        ForEach(data, size, entry.pattern, [&](std::size_t position) {
+                            if (position >= limit)
+                                return false;
+                            entry.matches.push_back(offset + position);
+                            entry.done = !entry.findAll;
+                            return entry.findAll;
+                        });
+                    }
+                }
+                return;
+            }
+
+            switch (ActiveEngine) {
+#if defined(SCANNER_X86)
+            case Engine::AVX2:
+                for (auto& follow : follows)
+                    Nibbles(follow.bits, follow.low, follow.high);
+                RunAVX2(data, size);
+                break;
+            case Engine::SSE2:
+                RunSSE2(data, size);
+                break;
+#endif
+            default:
+                RunScalar(data, size, 0);
+                break;
+            }
+        }
+
+        // Splits the range into chunks that overlap by the longest signature and scans them on the pool.
+        // Gives the same results as RunRange. Ranges too small to give every thread a couple of
+        // chunks are walked serially, splitting them costs more than it saves.
+        void RunRangeParallel(const std::uint8_t* data, std::size_t size, std::size_t offset, const Region* region, WorkerPool& pool)
+        {
+            std::size_t chunkSize = std::max<std::size_t>(MinChunkSize, size / (pool.Size() * 4) + 1);
+            if (pool.Size() <= 1 || size < pool.Size() * ParallelMinimum) {
+                RunRange(data, size, offset, region);
+                return;
+            }
+
+            std::size_t overlap = Overlap(region);
+            std::size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+            std::vector<std::vector<std::vector<std::size_t>>> chunkMatches(chunkCount);
+
+            pool.Run(chunkCount, [&](std::size_t chunk) {
+                Batch local;
+                local.entries.reserve(entries.size());
+                for (const auto& entry : entries)
+                    local.entries.push_back({ entry.pattern, entry.lead, entry.distance, entry.findAll, entry.region, entry.done, {} });
+
+                std::size_t begin = chunk * chunkSize;
+                std::size_t length = std::min(size - begin, chunkSize + overlap);
+                local.RunRange(data + begin, length, offset + begin, region, chunkSize);
+
+                chunkMatches[chunk].resize(entries.size());
+                for (std::size_t id = 0; id < entries.size(); ++id)
+                    chunkMatches[chunk][id] = std::move(local.entries[id].matches);
+            });
+
+            // Chunks are merged in address order so the first match is still the lowest one
+            for (std::size_t id = 0; id < entries.size(); ++id) {
+                auto& entry = entries[id];
+                if (entry.done || (region && entry.region != *region))
+                    continue;
+
+                for (std::size_t chunk = 0; chunk < chunkCount && !entry.done; ++chunk) {
+                    for (auto match : chunkMatches[chunk][id]) {
+                        entry.matches.push_back(match);
+                        if (!entry.findAll) {
+                            entry.done = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            Pattern pattern;
+            std::size_t lead = 0;       // Offset of the first filtered byte
+            std::size_t distance = 0;   // From it to the second, 0 with a single literal byte
+            bool findAll = false;
+            Region region = Region::Any;
+            bool done = false;
+            std::vector<std::size_t> matches;
+        };
+
+        // Bucket bits of the signatures whose second filtered byte is distance past the first,
+        // by the value of that byte
+        struct Follow
+        {
+            std::size_t distance = 0;
+            std::array<std::uint8_t, 256> bits{};
+            alignas(32) std::uint8_t low[32]{};     // Nibble tables of bits, filled for the AVX2 walk
+            alignas(32) std::uint8_t high[32]{};
+        };
+
+        static constexpr std::size_t MinChunkSize = 1 << 20;
+        static constexpr std::size_t ParallelMinimum = 2 * MinChunkSize;  // Per pool thread
+        static constexpr std::size_t SinglePassMinimum = 3;    // Where the single pass overtakes per signature scans
+
+        std::vector<Entry> entries;
+        std::array<std::vector<std::uint32_t>, 8> groups;   // Signatures by bucket bit
+        std::array<std::uint8_t, 256> leadBits{};           // By the value of the first filtered byte
+        std::vector<Follow> follows;
+        std::uint8_t unpaired = 0;                          // Bits that pass on the first byte alone
+        std::size_t remaining = 0;
+        std::size_t rangeOffset = 0;
+        std::size_t rangeLimit = npos;
+
+        // Splits bits into the two 16 byte nibble tables, each repeated for both lanes
+        static void Nibbles(const std::array<std::uint8_t, 256>& bits, std::uint8_t* low, std::uint8_t* high)
+        {
+            std::fill_n(low, 32, std::uint8_t(0));
+            std::fill_n(high, 32, std::uint8_t(0));
+            for (std::size_t b = 0; b < 256; ++b) {
+                low[b & 0x0F] |= bits[b];
+                low[16 + (b & 0x0F)] |= bits[b];
+                high[b >> 4] |= bits[b];
+                high[16 + (b >> 4)] |= bits[b];
+            }
+        }
+
+        std::size_t MaxDistance() const
+        {
+            std::size_t distance = 0;
+            for (const auto& follow : follows)
+                distance = std::max(distance, follow.distance);
+            return distance;
+        }
+
+        // Checks the signatures in the bucket bits a candidate at position hit, position being
+        // where their first filtered byte would be. Returns false once all signatures are done.
+        bool Dispatch(const std::uint8_t* data, std::size_t size, std::size_t position, std::uint8_t bits)
+        {
+            for (; bits; bits &= bits - 1) {
+                for (auto id : groups[std::countr_zero(bits)]) {
+                    auto& entry = entries[id];
+                    const auto& pattern = entry.pattern;
+                    if (entry.done || position < entry.lead)
+                        continue;
+
+                    std::size_t start = position - entry.lead;
+                    if (start >= rangeLimit || start + pattern.size() > size)
+                        continue;
+                    if (data[position] != pattern.bytes[entry.lead] || data[position + entry.distance] != pattern.bytes[entry.lead + entry.distance])
+                        continue;
+                    if (!Verify(data + start, pattern))
+                        continue;
+
+                    entry.matches.push_back(rangeOffset + start);
+                    if (!entry.findAll) {
+                        entry.done = true;
+                        if (--remaining == 0)
+                            return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void RunScalar(const std::uint8_t* data, std::size_t size, std::size_t start)
+        {
+            for (std::size_t i = start; i < size; ++i) {
+                auto bits = leadBits[data[i]];
+                if (!bits)
+                    continue;
+
+                // A second byte past the end means the signature doesn't fit here anyway
+                auto accepted = unpaired;
+                for (const auto& follow : follows) {
+                    if (i + follow.distance < size)
+                        accepted |= follow.bits[data[i + follow.distance]];
+                }
+                bits &= accepted;
+                if (bits && !Dispatch(data, size, i, bits))
+                    return;
+            }
+        }
+
+#if defined(SCANNER_X86)
+        void RunSSE2(const std::uint8_t* data, std::size_t size)
+        {
+            // No byte shuffle in SSE2, so compare against each signature's pair
+            struct Pair
+            {
+                __m128i first;
+                __m128i second;
+                __m128i bit;
+                std::size_t distance;
+            };
+            std::vector<Pair> pairs;
+            for (std::size_t group = 0; group < groups.size(); ++group) {
+                for (auto id : groups[group]) {
+                    const auto& entry = entries[id];
+                    pairs.push_back({ _mm_set1_epi8(static_cast<char>(entry.pattern.bytes[entry.lead])),
+                        _mm_set1_epi8(static_cast<char>(entry.pattern.bytes[entry.lead + entry.distance])),
+                        _mm_set1_epi8(static_cast<char>(1u << group)), entry.distance });
+                }
+            }
+
+            const auto reach = MaxDistance() + 16;
+            alignas(16) std::uint8_t bits[16];
+            std::size_t i = 0;
+            for (; i + reach <= size; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                __m128i hits = _mm_setzero_si128();
+                for (const auto& pair : pairs) {
+                    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + pair.distance));
+                    __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(v, pair.first), _mm_cmpeq_epi8(second, pair.second));
+                    hits = _mm_or_si128(hits, _mm_and_si128(hit, pair.bit));
+                }
+
+                auto candidates = ~static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128()))) & 0xFFFFu;
+                if (!candidates)
+                    continue;
+                _mm_store_si128(reinterpret_cast<__m128i*>(bits), hits);
+                for (; candidates; candidates &= candidates - 1) {
+                    auto j = std::countr_zero(candidates);
+                    if (!Dispatch(data, size, i + j, bits[j]))
+                        return;
+                }
+            }
+            RunScalar(data, size, i);
+        }
+
+        SCANNER_TARGET_AVX2 void RunAVX2(const std::uint8_t* data, std::size_t size)
+        {
+            // Shufti style lookups: the bucket bits whose byte has both of these nibbles. With
+            // one byte per bit, exactly the bits of the signatures that byte belongs to.
+            alignas(32) std::uint8_t leadTables[2][32];
+            Nibbles(leadBits, leadTables[0], leadTables[1]);
+            const __m256i leadLow = _mm256_load_si256(reinterpret_cast<const __m256i*>(leadTables[0]));
+            const __m256i leadHigh = _mm256_load_si256(reinterpret_cast<const __m256i*>(leadTables[1]));
+            const __m256i single = _mm256_set1_epi8(static_cast<char>(unpaired));
+            const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+            const auto reach = MaxDistance() + 32;
+            alignas(32) std::uint8_t bits[32];
+            std::size_t i = 0;
+            for (; i + reach <= size; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                __m256i first = _mm256_and_si256(_mm256_shuffle_epi8(leadLow, _mm256_and_si256(v, nibble)),
+                    _mm256_shuffle_epi8(leadHigh, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+                if (_mm256_testz_si256(first, first))
+                    continue;
+
+                __m256i accepted = single;
+                for (const auto& follow : follows) {
+                    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + follow.distance));
+                    __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i*>(follow.low));
+                    __m256i high = _mm256_load_si256(reinterpret_cast<const __m256i*>(follow.high));
+                    accepted = _mm256_or_si256(accepted, _mm256_and_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(w, nibble)),
+                        _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(w, 4), nibble))));
+                }
+                __m256i hits = _mm256_and_si256(first, accepted);
+
+                auto candidates = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, _mm256_setzero_si256())));
+                if (!candidates)
+                    continue;
+                _mm256_store_si256(reinterpret_cast<__m256i*>(bits), hits);
+                for (; candidates; candidates &= candidates - 1) {
+                    auto j = std::countr_zero(candidates);
+                    if (!Dispatch(data, size, i + j, bits[j]))
+                        return;
+                }
+            }
+            RunScalar(data, size, i);
+        }
+#endif
+    };
+
+    // Runs a batch over input that arrives in pieces, e.g. an executable read from disk, in
+    // bounded memory. Each window is scanned for matches that start before its last Overlap
+    // bytes, and those bytes are carried to the front of the next window, so a match split by
+    // a chunk boundary is still found exactly once and in ascending order. The results are the
+    // same as one RunRange over the whole input. Reset the batch before the first stream.
+    class Stream
+    {
+    public:
+        static constexpr std::size_t DefaultChunkSize = 1 << 20;
+
+        // Offsets are reported from offset, only signatures tagged with region are scanned when it's given
+        Stream(Batch& batch, std::size_t offset = 0, const Region* region = nullptr, std::size_t chunkSize = DefaultChunkSize)
+            : batch(batch), filtered(region != nullptr), region(region ? *region : Region::Any), chunkSize(std::max<std::size_t>(chunkSize, 1)), windowOffset(offset)
+        {
+            overlap = batch.Overlap(Filter());
+            window.resize(overlap + this->chunkSize);
+        }
+
+        Stream(const Stream&) = delete;
+        Stream& operator=(const Stream&) = delete;
+
+        // Space after the carried bytes for the next chunk. Fill some of it and Commit that much.
+        std::span<std::byte> Next() { return { reinterpret_cast<std::byte*>(window.data()) + held, chunkSize }; }
+
+        void Commit(std::size_t size)
+        {
+            auto total = held + std::min(size, chunkSize);
+            if (total <= overlap) {
+                held = total;
+                return;
+            }
+
+            auto scanned = total - overlap;
+            batch.RunRange(window.data(), total, windowOffset, Filter(), scanned);
+            std::memmove(window.data(), window.data() + scanned, overlap);
+            windowOffset += scanned;
+            held = overlap;
+        }
+
+        // Copies bytes in, a chunk at a time
+        void Feed(std::span<const std::byte> bytes)
+        {
+            while (!bytes.empty()) {
+                auto size = std::min(bytes.size(), chunkSize);
+                std::memcpy(Next().data(), bytes.data(), size);
+                Commit(size);
+                bytes = bytes.subspan(size);
+            }
+        }
+
+        // Scans the carried bytes, which nothing follows
+        void Finish()
+        {
+            if (held)
+                batch.RunRange(window.data(), held, windowOffset, Filter());
+            windowOffset += held;
+            held = 0;
+        }
+
+        // Offset of the next byte to be fed
+        std::size_t Position() const { return windowOffset + held; }
+
+        // Nothing left to find, the rest of the input can be skipped
+        bool Finished() const { return batch.Finished(Filter()); }
+
+    private:
+        const Region* Filter() const { return filtered ? &region : nullptr; }
+
+        Batch& batch;
+        bool filtered;
+        Region region;
+        std::size_t chunkSize;
+        std::size_t overlap = 0;
+        std::size_t windowOffset;
+        std::size_t held = 0;
+        std::vector<std::uint8_t> window;
+    };
+}
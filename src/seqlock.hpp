@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// A value published by a sequence lock. Readers copy it without locking and retry if a
+// write overlapped, so they never see a torn value. Writers are rare and serialise on the
+// sequence itself. The value is copied a word at a time through atomic_ref, which keeps
+// the racing reads well defined.
+template<typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock values are copied word by word");
+    static_assert(sizeof(T) % sizeof(std::uint32_t) == 0, "SeqLock values must be a whole number of words");
+
+public:
+    SeqLock() = default;
+    explicit SeqLock(const T& value) { std::memcpy(words, &value, sizeof(T)); }
+
+    T Load() const
+    {
+        T value;
+        Load(value);
+        return value;
+    }
+
+    // Copies the value and returns the version it was published as
+    std::uint32_t Load(T& value) const
+    {
+        for (;;) {
+            auto before = sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            LoadWords(reinterpret_cast<unsigned char*>(&value), std::make_index_sequence<WordCount>());
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before)
+                return before / 2;
+        }
+    }
+
+    void Publish(const T& value)
+    {
+        // Take the sequence from even to odd, waiting out any other writer
+        auto current = sequence.load(std::memory_order_relaxed);
+        while ((current & 1) || !sequence.compare_exchange_weak(current, current + 1, std::memory_order_relaxed))
+            current = sequence.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::uint32_t copy[WordCount];
+        std::memcpy(copy, &value, sizeof(T));
+        StoreWords(copy, std::make_index_sequence<WordCount>());
+
+        sequence.store(current + 2, std::memory_order_release);
+    }
+
+    // Number of values published so far
+    std::uint32_t Version() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    static constexpr std::size_t WordCount = sizeof(T) / sizeof(std::uint32_t);
+
+    // Unrolled, and written straight into the destination a word at a time. Going through a
+    // scratch array makes the caller's wider loads miss store forwarding.
+    template<std::size_t... I>
+    void LoadWords(unsigned char* value, std::index_sequence<I...>) const
+    {
+        (LoadWord(value + I * sizeof(std::uint32_t), words[I]), ...);
+    }
+
+    static void LoadWord(unsigned char* destination, std::uint32_t& word)
+    {
+        auto loaded = std::atomic_ref(word).load(std::memory_order_relaxed);
+        std::memcpy(destination, &loaded, sizeof(loaded));
+    }
+
+    template<std::size_t... I>
+    void StoreWords(const std::uint32_t* copy, std::index_sequence<I...>)
+    {
+        (std::atomic_ref(words[I]).store(copy[I], std::memory_order_relaxed), ...);
+    }
+
+    // Sequence and value share a cache line when the value fits
+    alignas(64) std::atomic<std::uint32_t> sequence = 0;
+    mutable std::uint32_t words[WordCount]{};
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "scanner.hpp"
+
+// Every hook site the fix looks for, compiled into byte and mask arrays at build time
+enum Signature
+{
+    ResolutionListSig,
+    ResolutionStringSig,
+    HUDSizeSig,
+    StartupHUDSizeSig,
+    HealthBars1Sig,
+    HealthBars2Sig,
+    FloatingMarkersSig,
+    HUDObjectsSig,
+    SignatureCount
+};
+
+// When a hook site is scanned and installed. Critical sites must be patched before the
+// game thread is released, deferred ones are installed in the background afterwards.
+enum class SignatureStage
+{
+    Critical,
+    Deferred
+};
+
+// The ini section that needs a hook site. Sites of disabled features aren't scanned for.
+enum class Feature
+{
+    CustomResolution,
+    FixHUD
+};
+
+struct SignatureInfo
+{
+    const char* name;
+    Scanner::Pattern pattern;
+    Scanner::Region region;
+    SignatureStage stage;
+    Feature feature;
+};
+
+namespace SignaturePatterns
+{
+    using namespace Scanner::Literals;
+
+    inline constexpr auto ResolutionList = "C0 03 00 00 00 04 00 00 60 04 00 00 00 05 00 00"_sig;
+    inline constexpr auto ResolutionString = "48 8B ?? 45 33 ?? 4D ?? ?? 49 ?? ?? 41 ?? ?? ?? E8 ?? ?? ?? ?? 45 33 ??"_sig;
+    inline constexpr auto HUDSize = "F3 0F ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? F3 0F ?? ?? ?? 48 83 ?? ?? E8 ?? ?? ?? ??"_sig;
+    inline constexpr auto StartupHUDSize = "F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? ?? F3 0F ?? ?? ?? E8 ?? ?? ?? ?? 48 8B ?? E8 ?? ?? ?? ??"_sig;
+    inline constexpr auto HealthBars1 = "0F 29 ?? ?? ?? 48 8B ?? ?? ?? 48 83 ?? ?? 74 ?? F3 0F ?? ?? ?? ?? ?? ?? 0F ?? ?? 77 ??"_sig;
+    inline constexpr auto HealthBars2 = "F3 0F ?? ?? F3 0F ?? ?? 66 0F ?? ?? ?? 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? E8 ?? ?? ?? ?? 84 ?? 74 ??"_sig;
+    inline constexpr auto FloatingMarkers = "F3 0F ?? ?? 66 0F ?? ?? ?? 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? E8 ?? ?? ?? ??"_sig;
+    inline constexpr auto HUDObjects = "41 8B ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ?? 41 ?? 01 00 00 00 89 ?? ?? ?? ?? ?? ??"_sig;
+}
+
+// Hook sites are all in code, the resolution table lives in initialized data.
+// The resolution patches have to land before the game builds its options, the HUD can wait.
+inline constexpr SignatureInfo Signatures[SignatureCount] = {
+    { "Resolution List", SignaturePatterns::ResolutionList, Scanner::Region::Data, SignatureStage::Critical, Feature::CustomResolution },
+    { "Resolution String", SignaturePatterns::ResolutionString, Scanner::Region::Code, SignatureStage::Critical, Feature::CustomResolution },
+    { "HUD Size", SignaturePatterns::HUDSize, Scanner::Region::Code, SignatureStage::Deferred, Feature::FixHUD },
+    { "Startup HUD Size", SignaturePatterns::StartupHUDSize, Scanner::Region::Code, SignatureStage::Deferred, Feature::FixHUD },
+    { "Health Bars 1", SignaturePatterns::HealthBars1, Scanner::Region::Code, SignatureStage::Deferred, Feature::FixHUD },
+    { "Health Bars 2", SignaturePatterns::HealthBars2, Scanner::Region::Code, SignatureStage::Deferred, Feature::FixHUD },
+    { "Floating Markers", SignaturePatterns::FloatingMarkers, Scanner::Region::Code, SignatureStage::Deferred, Feature::FixHUD },
+    { "HUD Objects", SignaturePatterns::HUDObjects, Scanner::Region::Code, SignatureStage::Deferred, Feature::FixHUD },
+};
+
+// RIP-relative operands at fixed offsets of a hook site, for tools that don't decode it.
+// The fix reads the same globals from the decoded site with Memory::GetDataReferences.
+enum Indirection
+{
+    HUDSizeYRef,
+    HUDSizeXRef,
+    IndirectionCount
+};
+
+struct IndirectionInfo
+{
+    const char* name;
+    Signature signature;
+    std::uint32_t offset;   // Of the disp32 from the start of the match
+};
+
+// The startup site loads height then width
+inline constexpr IndirectionInfo Indirections[IndirectionCount] = {
+    { "HUD Size Y", StartupHUDSizeSig, 0x4 },
+    { "HUD Size X", StartupHUDSizeSig, 0xC },
+};
@@ -3,7 +3,12 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include <windows.h>
+#include <array>
 #include <cassert>
+#include <charconv>
+#include <chrono>
 #include <fstream>
 #include <filesystem>
+#include <map>
+#include <string_view>
 #include <vector>
\ No newline at end of file
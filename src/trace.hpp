@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Startup timeline. Nested begin/end spans go into a fixed buffer with the thread that made
+// them, and Write turns the buffer into a Chrome trace_event file for chrome://tracing or
+// Perfetto. Recording is a couple of stores, so spans are always on during startup and only
+// written out when asked for.
+namespace Trace
+{
+    struct Event
+    {
+        const char* name;
+        std::int64_t time;      // Nanoseconds since the module was loaded
+        std::uint32_t thread;
+        char phase;             // 'B' or 'E'
+    };
+
+    inline constexpr std::size_t Capacity = 4096;
+
+    inline std::array<Event, Capacity> Events;
+    inline std::atomic<std::size_t> Count = 0;
+    inline const auto Origin = std::chrono::steady_clock::now();
+
+    inline std::uint32_t ThreadId()
+    {
+#ifdef _WIN32
+        return GetCurrentThreadId();
+#else
+        return static_cast<std::uint32_t>(gettid());
+#endif
+    }
+
+    // Events past the end of the buffer are dropped and counted
+    inline void Record(const char* name, char phase)
+    {
+        auto index = Count.fetch_add(1, std::memory_order_relaxed);
+        if (index >= Capacity)
+            return;
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Origin).count();
+        Events[index] = { name, time, ThreadId(), phase };
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name) : name(name) { Record(name, 'B'); }
+        ~Scope() { Record(name, 'E'); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+    };
+
+    inline std::size_t Dropped()
+    {
+        auto count = Count.load(std::memory_order_acquire);
+        return count > Capacity ? count - Capacity : 0;
+    }
+
+    // Writes every event recorded so far. Spans still open are closed by the viewer.
+    inline bool Write(const std::filesystem::path& path)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file)
+            return false;
+
+        auto count = std::min(Count.load(std::memory_order_acquire), Capacity);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << std::fixed << std::setprecision(3);
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& event = Events[i];
+            file << "{\"name\":\"";
+            for (auto c = event.name; *c; ++c) {
+                if (*c == '"' || *c == '\\')
+                    file << '\\';
+                file << *c;
+            }
+            file << "\",\"ph\":\"" << event.phase << "\",\"ts\":" << event.time / 1000.0 << ",\"pid\":1,\"tid\":" << event.thread << "}";
+            file << (i + 1 < count ? ",\n" : "\n");
+        }
+        file << "]}\n";
+        return static_cast<bool>(file);
+    }
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "pe.hpp"
+
+#include <Zydis.h>
+
+#include <algorithm>
+#include <span>
+
+// Cross references found by a linear sweep of a range of code with Zydis: every RIP-relative
+// memory operand and every relative call or jump, sorted by site. Used to read the globals a
+// hook site refers to from the decoded instructions instead of from fixed operand offsets.
+namespace XRefs
+{
+    enum class Kind : std::uint8_t
+    {
+        Data,   // RIP-relative memory operand
+        Call,
+        Jump
+    };
+
+    struct Reference
+    {
+        std::uint32_t site = 0;         // Rva of the instruction
+        std::uint32_t target = 0;       // Rva it refers to
+        std::uint16_t mnemonic = 0;     // ZydisMnemonic
+        std::uint8_t length = 0;
+        Kind kind = Kind::Data;
+    };
+
+    static_assert(sizeof(Reference) == 12, "References are packed into 12 bytes");
+
+    class Index
+    {
+    public:
+        // References made by instructions starting in [begin, end), in address order
+        std::span<const Reference> From(std::uint32_t begin, std::uint32_t end) const
+        {
+            auto first = std::lower_bound(bySite.begin(), bySite.end(), begin, [](const Reference& r, std::uint32_t rva) { return r.site < rva; });
+            auto last = std::lower_bound(first, bySite.end(), end, [](const Reference& r, std::uint32_t rva) { return r.site < rva; });
+            return { first, last };
+        }
+
+        std::size_t Count() const { return bySite.size(); }
+
+        void Add(const Reference& reference) { bySite.push_back(reference); }
+
+        // Sorts by site once every reference has been added
+        void Finish()
+        {
+            std::sort(bySite.begin(), bySite.end(), [](const Reference& a, const Reference& b) { return a.site < b.site; });
+        }
+
+    private:
+        std::vector<Reference> bySite;
+    };
+
+    // Decodes [begin, end) of the module and adds every reference that lands inside the image.
+    // Bytes that don't decode are skipped one at a time, so padding and jump tables only cost a little.
+    void Sweep(const PE::Module& module, std::uint32_t begin, std::uint32_t end, Index& index)
+    {
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+
+        end = std::min(end, module.sizeOfImage);
+        ZydisDecodedInstruction instruction;
+        for (std::uint32_t rva = begin; rva < end;) {
+            if (ZYAN_FAILED(ZydisDecoderDecodeInstruction(&decoder, nullptr, module.base + rva, end - rva, &instruction))) {
+                ++rva;
+                continue;
+            }
+
+            if (instruction.attributes & ZYDIS_ATTRIB_IS_RELATIVE) {
+                Reference reference;
+                reference.site = rva;
+                reference.mnemonic = static_cast<std::uint16_t>(instruction.mnemonic);
+                reference.length = instruction.length;
+
+                // A relative immediate is a branch target, otherwise the displacement is a memory
+                // operand. call [rip+x] through an import slot counts as a data reference to the slot.
+                std::int64_t displacement = instruction.raw.disp.value;
+                for (const auto& imm : instruction.raw.imm) {
+                    if (imm.is_relative) {
+                        displacement = imm.value.s;
+                        reference.kind = instruction.meta.category == ZYDIS_CATEGORY_CALL ? Kind::Call : Kind::Jump;
+                    }
+                }
+
+                auto target = static_cast<std::int64_t>(rva) + instruction.length + displacement;
+                if (target >= 0 && target < module.sizeOfImage) {
+                    reference.target = static_cast<std::uint32_t>(target);
+                    index.Add(reference);
+                }
+            }
+
+            rva += instruction.length;
+        }
+    }
+
+    // Index of a range, e.g. just the bytes of one hook site
+    Index Build(const PE::Module& module, std::uint32_t begin, std::uint32_t end)
+    {
+        Index index;
+        Sweep(module, begin, end, index);
+        index.Finish();
+        return index;
+    }
+}
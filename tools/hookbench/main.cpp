@@ -0,0 +1,358 @@
+// HUD hook body benchmark.
+// Drives the HUD Objects, Health Bars and Floating Markers hook bodies over a fake register
+// context and fake HUD object records, at a few common resolutions, and prints ns/call and
+// throughput so per-frame overhead can be compared between builds.
+//
+//   hookbench [--objects N] [--frames N]
+//
+// HUD Objects runs three times per resolution: cold, with the result cache invalidated every
+// frame as after a resize, warm, the steady state where every object is already cached, and
+// warm with the HUD census recording every object.
+// In the game Health Bars 2 and the Floating Markers are LightHook add stubs with no callback,
+// their bodies are timed here as the reference for what those stubs do.
+// Before the timings, the hook registry is run against hooks that fail on request, to check
+// that a failed toggle is tried again, and write sessions are run against mprotect, to check
+// that every page is written and put back the way it was found. Exits with failure if either
+// check fails.
+
+#include "hookregistry.hpp"
+#include "hudhooks.hpp"
+#include "protect.hpp"
+#include "seqlock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace
+{
+    // Register layout the hooks read, mirroring safetyhook::Context64
+    union Xmm
+    {
+        std::uint8_t u8[16];
+        std::uint32_t u32[4];
+        float f32[4];
+        double f64[2];
+    };
+
+    struct Context
+    {
+        Xmm xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7, xmm8, xmm9, xmm10, xmm11, xmm12, xmm13, xmm14, xmm15;
+        std::uintptr_t rflags, r15, r14, r13, r12, r11, r10, r9, r8, rdi, rsi, rdx, rcx, rbx, rax, rbp, rsp, trampoline_rsp, rip;
+    };
+
+    // HUD object record as the hook sees it: the name at +0, the offset at +0x50 and the size at +0x60/+0x62
+    struct alignas(16) Record
+    {
+        char name[HUDHooks::Object::Offset];
+        float offset;
+        std::uint8_t padding[HUDHooks::Object::Width - HUDHooks::Object::Offset - sizeof(float)];
+        short width;
+        short height;
+        std::uint8_t tail[0x1C];
+    };
+
+    static_assert(offsetof(Record, offset) == HUDHooks::Object::Offset);
+    static_assert(offsetof(Record, width) == HUDHooks::Object::Width);
+    static_assert(offsetof(Record, height) == HUDHooks::Object::Height);
+
+    struct Kind
+    {
+        const char* name;
+        short width;
+        short height;
+        int weight;
+    };
+
+    // Roughly what a busy frame draws: mostly icons and text that no rule touches, a few
+    // backgrounds and fades that get rescaled, and the occasional map or damage frame.
+    constexpr Kind Kinds[] = {
+        { "PIC_icon_skill_%02d", 64, 64, 30 },
+        { "TXT_label_status_%02d", 240, 32, 25 },
+        { "PIC_gauge_hp_fill_%02d", 512, 24, 10 },
+        { "PIC_btn_prompt_%02d", 48, 48, 10 },
+        { "PIC_parts_header_bg_tab_%02d", 320, 64, 4 },
+        { "PIC_common_square_bl_%02d", 1920, 1080, 2 },
+        { "PIC_bg_rect_window_%02d", 1920, 1080, 3 },
+        { "PIC_mask_bg_%02d", 2048, 1152, 2 },
+        { "PIC_black_%02d", 1920, 1080, 2 },
+        { "PIC_square_w_%02d", 1920, 200, 2 },
+        { "PIC_bottomGradation_%02d", 2880, 400, 2 },
+        { "WIN_base_system_bg_%02d", 2600, 1463, 1 },
+        { "bg_strategy_book_%02d", 1920, 1080, 1 },
+        { "PIC_bg_frame_damage_l_%02d", 540, 1080, 1 },
+        { "PIC_bg_frame_damage_r_%02d", 540, 1080, 1 },
+        { "ui_letterbox_%02d", 1920, 140, 2 },
+        { "capture_plane_full_rgba8_%02d", 1920, 1080, 1 },
+    };
+
+    std::vector<Record> MakeRecords(std::size_t count)
+    {
+        std::mt19937 rng(14);
+        std::vector<int> weights;
+        for (const auto& kind : Kinds)
+            weights.push_back(kind.weight);
+        std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+
+        std::vector<Record> records(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& kind = Kinds[pick(rng)];
+            auto& record = records[i];
+            std::memset(&record, 0, sizeof(record));
+            std::snprintf(record.name, sizeof(record.name), kind.name, static_cast<int>(i % 100));
+            record.width = kind.width;
+            record.height = kind.height;
+        }
+        return records;
+    }
+
+    struct Resolution
+    {
+        const char* name;
+        int width;
+        int height;
+    };
+
+    constexpr Resolution Resolutions[] = {
+        { "16:9", 2560, 1440 },
+        { "21:9", 3440, 1440 },
+        { "32:9", 5120, 1440 },
+        { "16:10", 2560, 1600 },
+    };
+
+    // Keeps the optimiser from dropping hook writes nobody reads
+    std::uintptr_t Sink = 0;
+
+    void Consume(const Context& ctx)
+    {
+        Sink += ctx.rax ^ ctx.xmm0.u32[0] ^ ctx.xmm3.u32[0] ^ ctx.xmm4.u32[0] ^ ctx.xmm5.u32[0] ^ ctx.xmm6.u32[0];
+    }
+
+    struct Timing
+    {
+        std::string hook;
+        std::size_t calls;
+        double seconds;
+    };
+
+    template<typename Function>
+    Timing Time(std::string hook, std::size_t frames, std::size_t callsPerFrame, Function&& function)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t frame = 0; frame < frames; ++frame)
+            function();
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return { std::move(hook), frames * callsPerFrame, seconds };
+    }
+
+    void Run(const Resolution& resolution, std::vector<Record>& records, std::size_t frames)
+    {
+        // Hooks read the display through the seqlock, as they do in the game
+        HUDHooks::Display display;
+        display.Calculate(resolution.width, resolution.height);
+        SeqLock<HUDHooks::Display> state(display);
+
+        auto objects = std::make_unique<HUDHooks::Objects>();
+        Context ctx{};
+        std::vector<Timing> timings;
+
+        auto objectPass = [&] {
+            for (auto& record : records) {
+                ctx.r12 = reinterpret_cast<std::uintptr_t>(&record);
+                ctx.rax = 0;
+                HUDHooks::HUDObjects(ctx, *objects, state);
+                Consume(ctx);
+            }
+        };
+
+        timings.push_back(Time("HUD Objects cold", frames, records.size(), [&] {
+            objects->Invalidate();
+            objectPass();
+        }));
+        timings.push_back(Time("HUD Objects warm", frames, records.size(), objectPass));
+
+        // Warm again with every object counted into the census table
+        auto census = std::make_unique<HUDCensus>();
+        objects->census = census.get();
+        timings.push_back(Time("HUD Objects census", frames, records.size(), objectPass));
+        objects->census = nullptr;
+
+        // The marker and health bar hooks run once per visible unit, take that as one per object
+        auto perObject = [&](auto&& hook) {
+            return [&, hook] {
+                for (std::size_t i = 0; i < records.size(); ++i) {
+                    ctx.xmm0.f32[0] = ctx.xmm3.f32[0] = ctx.xmm4.f32[0] = static_cast<float>(i);
+                    hook(ctx, state.Load());
+                    Consume(ctx);
+                }
+            };
+        };
+
+        timings.push_back(Time("Health Bars 1", frames, records.size(), perObject([](Context& c, const HUDHooks::Display& d) { HUDHooks::HealthBars1(c, d); })));
+        timings.push_back(Time("Health Bars 2", frames, records.size(), perObject([](Context& c, const HUDHooks::Display& d) { HUDHooks::HealthBars2(c, d); })));
+        timings.push_back(Time("Floating Markers H", frames, records.size(), perObject([](Context& c, const HUDHooks::Display& d) { HUDHooks::FloatingMarkersHorizontal(c, d); })));
+        timings.push_back(Time("Floating Markers V", frames, records.size(), perObject([](Context& c, const HUDHooks::Display& d) { HUDHooks::FloatingMarkersVertical(c, d); })));
+
+        std::printf("\n%s (%dx%d, aspect %.4f), %zu objects x %zu frames\n", resolution.name, resolution.width, resolution.height, display.aspectRatio, records.size(), frames);
+        std::printf("%-20s %12s %10s %14s %14s\n", "Hook", "Calls", "ns/call", "Mcalls/s", "us/frame");
+        for (const auto& timing : timings) {
+            auto ns = timing.seconds * 1e9 / static_cast<double>(timing.calls);
+            std::printf("%-20s %12zu %10.2f %14.2f %14.2f\n", timing.hook.c_str(), timing.calls, ns,
+                static_cast<double>(timing.calls) / timing.seconds / 1e6, timing.seconds * 1e6 / static_cast<double>(frames));
+        }
+    }
+
+    // Stands in for a LightHook::Hook, failing as many toggles as it's told to
+    struct FakeHook
+    {
+        std::atomic<bool> enabled = true;
+        std::atomic<int> toggles = 0;
+        std::atomic<int> failures = 0;
+
+        explicit operator bool() const { return true; }
+        bool Enable() { return Toggle(true); }
+        bool Disable() { return Toggle(false); }
+
+        bool Toggle(bool on)
+        {
+            ++toggles;
+            if (failures > 0) {
+                --failures;
+                return false;
+            }
+            enabled = on;
+            return true;
+        }
+    };
+
+    // Waits up to a second for the registry's worker to reach toggles
+    bool WaitForToggles(const FakeHook& hook, int toggles)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (hook.toggles < toggles && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return hook.toggles == toggles;
+    }
+
+    HUDHooks::Display MakeDisplay(int width, int height)
+    {
+        HUDHooks::Display display;
+        display.Calculate(width, height);
+        return display;
+    }
+
+    // A toggle that fails when a 21:9 display is applied has to be tried again when the next
+    // 21:9 display is requested, and a display in an applied class must not toggle anything
+    bool CheckRegistry()
+    {
+        FakeHook wider, narrower;
+        narrower.failures = 1;
+
+        BasicHookRegistry<FakeHook> registry;
+        registry.Add("Wider", wider, BasicHookRegistry<FakeHook>::Wider);
+        registry.Add("Narrower", narrower, BasicHookRegistry<FakeHook>::Narrower);
+        registry.Start();
+
+        registry.Request(MakeDisplay(3440, 1440));
+        bool failed = WaitForToggles(narrower, 1) && narrower.enabled;
+
+        registry.Request(MakeDisplay(2560, 1080));
+        bool retried = WaitForToggles(narrower, 2) && !narrower.enabled;
+
+        registry.Request(MakeDisplay(5120, 1440));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        bool settled = narrower.toggles == 2 && wider.toggles == 0 && wider.enabled;
+        registry.Stop();
+
+        bool ok = failed && retried && settled;
+        std::printf("Hook registry: failed toggle retried on the next request: %s\n", ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    // Maps three pages, read-only, read-write and no-access, runs a session and an uncommitted
+    // transaction over all of them, and checks the values and protections they leave behind
+    bool CheckProtect()
+    {
+        auto pageSize = Protect::Native.pageSize();
+        auto pages = static_cast<std::uint8_t*>(mmap(nullptr, pageSize * 3, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (pages == MAP_FAILED)
+            return false;
+
+        std::uint8_t* targets[] = { pages, pages + pageSize, pages + pageSize * 2 };
+        const std::uint32_t protections[] = { PROT_READ, PROT_READ | PROT_WRITE, PROT_NONE };
+        mprotect(targets[0], pageSize, PROT_READ);
+        mprotect(targets[2], pageSize, PROT_NONE);
+
+        auto protectionsKept = [&] {
+            for (std::size_t i = 0; i < std::size(targets); ++i) {
+                if (Protect::QueryProtection(targets[i]) != protections[i])
+                    return false;
+            }
+            return true;
+        };
+
+        bool ok = true;
+        {
+            Protect::WriteSession session;
+            for (auto target : targets)
+                ok &= session.Write(target, 2.5f);
+            ok &= session.PageCount() == 3;
+            ok &= Protect::QueryProtection(targets[0]) == (PROT_READ | PROT_WRITE);
+            session.Restore();
+            ok &= protectionsKept();
+        }
+
+        {
+            Protect::Transaction transaction;
+            for (auto target : targets)
+                ok &= transaction.Patch(target, "\0\0\0\0", 4);
+        }
+        ok &= protectionsKept();
+
+        mprotect(targets[2], pageSize, PROT_READ);
+        for (auto target : targets) {
+            float value;
+            std::memcpy(&value, target, sizeof(value));
+            ok &= value == 2.5f;
+        }
+
+        munmap(pages, pageSize * 3);
+        std::printf("Protect: write sessions against mprotect: %s\n", ok ? "ok" : "FAILED");
+        return ok;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t objects = 400;
+    std::size_t frames = 2000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--objects" && i + 1 < argc)
+            objects = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        else if (argument == "--frames" && i + 1 < argc)
+            frames = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+    }
+
+    if (!CheckRegistry() || !CheckProtect())
+        return EXIT_FAILURE;
+
+    auto records = MakeRecords(objects);
+    for (const auto& resolution : Resolutions)
+        Run(resolution, records, frames);
+
+    std::printf("\nChecksum: %zx\n", static_cast<std::size_t>(Sink));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+// Offset table generator for new game builds.
+// Reads the game executable from disk, scans it for every signature the fix uses and follows
+// the RIP-relative globals the fix reads from them, so a patch can be checked without
+// launching the game. Prints each signature's match count, offsets and scan time, and merges
+// the first match of each into an offset table keyed by the executable's TimeDateStamp.
+//
+//   offsettable <game exe> [--out FateSamuraiRemnantFix.offsets] [--read] [--chunk KB]
+//
+// Put the table next to the .asi. The fix checks each entry against the signature before
+// using it, same as its own cache, so a stale table only costs the scan it would do anyway.
+// Exits with failure if any signature is missing.
+
+#include "offsetcache.hpp"
+#include "pefile.hpp"
+#include "signatures.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char* RegionName(Scanner::Region region)
+    {
+        switch (region) {
+        case Scanner::Region::Code: return "Code";
+        case Scanner::Region::Data: return "Data";
+        default: return "Any";
+        }
+    }
+
+    std::string SectionName(const PE::Module& module, std::size_t rva)
+    {
+        for (const auto& section : module.sections) {
+            if (rva >= section.rva && rva - section.rva < section.size)
+                return section.name;
+        }
+        return rva < module.sizeOfHeaders ? "headers" : "-";
+    }
+
+    struct Result
+    {
+        std::vector<std::size_t> matches;
+        double seconds = 0;
+    };
+
+    // Every match of one signature, streamed from the file the way the fix scans the loaded image
+    template<typename Source>
+    bool ScanSignature(Source& source, const PE::Module& module, const SignatureInfo& signature, std::size_t chunkSize, Result& result)
+    {
+        Scanner::Batch batch;
+        batch.Add(signature.pattern, true, signature.region);
+
+        auto start = std::chrono::steady_clock::now();
+        bool read = PE::PatternScanBatch(source, module, batch, chunkSize);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.matches = batch.All(0);
+        return read;
+    }
+
+    // What Memory::GetAbsolute returns for the disp32 at rva, as an rva
+    template<typename Source>
+    std::size_t ResolveAbsolute(Source& source, const PE::Module& module, std::uint32_t rva)
+    {
+        auto offset = PE::RvaToFileOffset(module, rva);
+        std::int32_t displacement = 0;
+        if (offset == Scanner::npos || source.Read(offset, std::as_writable_bytes(std::span(&displacement, 1))) != sizeof(displacement))
+            return Scanner::npos;
+
+        auto target = static_cast<std::int64_t>(rva) + 4 + displacement;
+        return target >= 0 && target < module.sizeOfImage ? static_cast<std::size_t>(target) : Scanner::npos;
+    }
+
+    template<typename Source>
+    int Run(Source& source, const std::filesystem::path& output, std::size_t chunkSize)
+    {
+        auto module = PE::LoadFile(source);
+        if (!module) {
+            std::fprintf(stderr, "Not a PE image.\n");
+            return EXIT_FAILURE;
+        }
+
+        std::printf("Timestamp %08X, image base %llX, %u bytes mapped, %zu sections\n\n", module->timestamp,
+            static_cast<unsigned long long>(module->imageBase), module->sizeOfImage, module->sections.size());
+
+        std::vector<Result> results(SignatureCount);
+        double total = 0;
+        for (std::size_t i = 0; i < SignatureCount; ++i) {
+            if (!ScanSignature(source, *module, Signatures[i], chunkSize, results[i])) {
+                std::fprintf(stderr, "Failed to read the file.\n");
+                return EXIT_FAILURE;
+            }
+            total += results[i].seconds;
+        }
+
+        bool ok = true;
+        std::printf("%-18s %-6s %8s %10s %12s %18s %-8s %10s\n", "Signature", "Region", "Matches", "Rva", "File offset", "Address", "Section", "ms");
+        for (std::size_t i = 0; i < SignatureCount; ++i) {
+            const auto& signature = Signatures[i];
+            const auto& matches = results[i].matches;
+            if (matches.empty()) {
+                std::printf("%-18s %-6s %8d %10s %12s %18s %-8s %10.2f  MISSING\n", signature.name, RegionName(signature.region), 0, "-", "-", "-", "-", results[i].seconds * 1e3);
+                ok = false;
+                continue;
+            }
+
+            // The fix takes the first match, more than one means the signature has become ambiguous
+            auto rva = matches.front();
+            std::printf("%-18s %-6s %8zu %10zX %12zX %18llX %-8s %10.2f%s\n", signature.name, RegionName(signature.region), matches.size(), rva,
+                PE::RvaToFileOffset(*module, static_cast<std::uint32_t>(rva)), static_cast<unsigned long long>(module->imageBase + rva),
+                SectionName(*module, rva).c_str(), results[i].seconds * 1e3, matches.size() > 1 ? "  AMBIGUOUS" : "");
+        }
+        std::printf("%-18s %-6s %8s %10s %12s %18s %-8s %10.2f\n", "Total", "", "", "", "", "", "", total * 1e3);
+
+        std::printf("\n%-18s %-18s %8s %10s %18s %-8s\n", "Indirection", "From", "Offset", "Rva", "Address", "Section");
+        for (const auto& indirection : Indirections) {
+            const auto& matches = results[indirection.signature].matches;
+            auto target = matches.empty() ? Scanner::npos : ResolveAbsolute(source, *module, static_cast<std::uint32_t>(matches.front() + indirection.offset));
+            if (target == Scanner::npos) {
+                std::printf("%-18s %-18s %8X %10s %18s %-8s  UNRESOLVED\n", indirection.name, Signatures[indirection.signature].name, indirection.offset, "-", "-", "-");
+                ok = false;
+                continue;
+            }
+            std::printf("%-18s %-18s %8X %10zX %18llX %-8s\n", indirection.name, Signatures[indirection.signature].name, indirection.offset, target,
+                static_cast<unsigned long long>(module->imageBase + target), SectionName(*module, target).c_str());
+        }
+
+        // Merged, so one table covers every build it has been run on
+        OffsetCache table;
+        table.Load(output);
+        for (std::size_t i = 0; i < SignatureCount; ++i) {
+            auto hash = OffsetCache::Hash(Signatures[i].pattern, Signatures[i].region);
+            if (results[i].matches.empty())
+                table.Erase(module->timestamp, hash);
+            else
+                table.Store(module->timestamp, hash, static_cast<std::uint32_t>(results[i].matches.front()));
+        }
+
+        if (!table.Save(output)) {
+            std::fprintf(stderr, "\nFailed to write %s\n", output.string().c_str());
+            return EXIT_FAILURE;
+        }
+        std::printf("\nWrote %s (%zu builds)\n", output.string().c_str(), table.Builds().size());
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path input;
+    std::filesystem::path output = "FateSamuraiRemnantFix.offsets";
+    std::size_t chunkSize = Scanner::Stream::DefaultChunkSize;
+    bool read = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--out" && i + 1 < argc)
+            output = argv[++i];
+        else if (argument == "--chunk" && i + 1 < argc)
+            chunkSize = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1) << 10;
+        else if (argument == "--read")
+            read = true;
+        else
+            input = argument;
+    }
+
+    if (input.empty()) {
+        std::fprintf(stderr, "Usage: offsettable <game exe> [--out file] [--read] [--chunk KB]\n");
+        return EXIT_FAILURE;
+    }
+
+    // Mapped by default, --read goes through one chunk sized buffer instead
+    if (read) {
+        PE::FileReader reader;
+        if (reader.Open(input))
+            return Run(reader, output, chunkSize);
+    }
+    else {
+        PE::MappedFile mapped;
+        if (mapped.Open(input))
+            return Run(mapped, output, chunkSize);
+    }
+
+    std::fprintf(stderr, "Failed to open %s\n", input.string().c_str());
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,343 @@
+// Scanner benchmark and differential test.
+// Builds synthetic PE images, scans them for the fix's real signatures with every engine and
+// checks each result against the original byte-by-byte scanner.
+//
+//   scanbench [size in MB ...] [--threads N]
+//
+// --threads caps the pool scaling rows, which default to the hardware thread count up to 8.
+//
+// Memory::PatternScan, PatternScanAll and MultiPatternScan need windows.h, so the portable
+// code they forward to is measured instead: Scanner::FindFirst, Scanner::FindAll,
+// Scanner::Matches, Scanner::FindUnique and Scanner::Batch over the flat image, and
+// PE::PatternScan/PatternScanBatch per section.
+// MultiPatternScan is checked the way the fix always defined it: the first match of the first
+// signature in the list that matches anywhere in the flat image. The per-section batch the fix
+// scans its own signatures with is checked against each signature's first match in its region.
+// The image is also written out with a packed file layout and streamed back from disk in
+// small and default sized chunks, through plain reads and through a memory map.
+
+#include "pe.hpp"
+#include "pefile.hpp"
+#include "scanner.hpp"
+#include "signatures.hpp"
+#include "synthetic.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // The scanner the fix shipped with: every position, every byte
+    template<typename Callback>
+    void NaiveForEach(const std::uint8_t* data, std::size_t positions, const Scanner::Pattern& pattern, Callback&& callback)
+    {
+        for (std::size_t i = 0; i < positions; ++i) {
+            bool found = true;
+            for (std::size_t j = 0; j < pattern.size(); ++j) {
+                if (pattern.mask[j] && data[i + j] != pattern.bytes[j]) {
+                    found = false;
+                    break;
+                }
+            }
+            if (found && !callback(i))
+                return;
+        }
+    }
+
+    // Positions Memory::PatternScan has always covered, i < SizeOfImage - length
+    std::size_t FlatPositions(const PE::Module& module, const Scanner::Pattern& pattern)
+    {
+        return module.sizeOfImage > pattern.size() ? module.sizeOfImage - pattern.size() : 0;
+    }
+
+    std::size_t NaiveFirst(const PE::Module& module, const Scanner::Pattern& pattern)
+    {
+        std::size_t result = Scanner::npos;
+        NaiveForEach(module.base, FlatPositions(module, pattern), pattern, [&](std::size_t offset) {
+            result = offset;
+            return false;
+        });
+        return result;
+    }
+
+    std::vector<std::size_t> NaiveAll(const PE::Module& module, const Scanner::Pattern& pattern)
+    {
+        std::vector<std::size_t> results;
+        NaiveForEach(module.base, FlatPositions(module, pattern), pattern, [&](std::size_t offset) {
+            results.push_back(offset);
+            return true;
+        });
+        return results;
+    }
+
+    std::size_t NaiveFirstInRegion(const PE::Module& module, const Scanner::Pattern& pattern, Scanner::Region region)
+    {
+        if (region == Scanner::Region::Any)
+            return NaiveFirst(module, pattern);
+
+        for (const auto& section : module.sections) {
+            if (!section.In(region) || section.size < pattern.size())
+                continue;
+            std::size_t result = Scanner::npos;
+            NaiveForEach(module.base + section.rva, section.size - pattern.size() + 1, pattern, [&](std::size_t offset) {
+                result = section.rva + offset;
+                return false;
+            });
+            if (result != Scanner::npos)
+                return result;
+        }
+        return Scanner::npos;
+    }
+
+    struct Timing
+    {
+        const char* operation;
+        std::string engine;
+        double seconds;
+        bool matches;
+    };
+
+    double Time(const std::function<void()>& function)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Hook sites late in .text so first-match scans walk most of the image, with a second
+    // copy of each for PatternScanAll. The resolution list goes in the middle of .rdata.
+    void PlantSignatures(Synthetic::Image& image)
+    {
+        std::mt19937 rng(7);
+        auto base = image.bytes.data();
+        for (std::size_t i = 0; i < SignatureCount; ++i) {
+            const auto& signature = Signatures[i];
+            if (signature.region == Scanner::Region::Data) {
+                Synthetic::Plant(base + image.rdataRva + image.rdataSize / 2 + i * 0x100, signature.pattern, rng);
+                continue;
+            }
+            Synthetic::Plant(base + image.textRva + image.textSize / 10 * 9 + i * 0x100, signature.pattern, rng);
+            Synthetic::Plant(base + image.textRva + image.textSize / 20 * 19 + i * 0x100, signature.pattern, rng);
+        }
+    }
+
+    bool Run(std::size_t megabytes, std::size_t threads)
+    {
+        auto image = Synthetic::Make(megabytes << 20);
+        PlantSignatures(image);
+        auto module = PE::Load(image.bytes.data());
+        auto bytes = static_cast<double>(module.sizeOfImage);
+
+        std::printf("\n%zu MB image, %zu signatures\n", megabytes, static_cast<std::size_t>(SignatureCount));
+
+        // References
+        std::vector<std::size_t> firsts(SignatureCount), regionFirsts(SignatureCount);
+        std::vector<std::vector<std::size_t>> alls(SignatureCount);
+        std::size_t multiFirst = Scanner::npos;
+        std::vector<Timing> timings;
+
+        timings.push_back({ "PatternScan", "Naive", Time([&] {
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                firsts[i] = NaiveFirst(module, Signatures[i].pattern);
+        }), true });
+        timings.push_back({ "PatternScanAll", "Naive", Time([&] {
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                alls[i] = NaiveAll(module, Signatures[i].pattern);
+        }), true });
+        timings.push_back({ "MultiPatternScan", "Naive", Time([&] {
+            for (std::size_t i = 0; i < SignatureCount && multiFirst == Scanner::npos; ++i)
+                multiFirst = NaiveFirst(module, Signatures[i].pattern);
+        }), true });
+        timings.push_back({ "PatternScanBatch", "Naive", Time([&] {
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                regionFirsts[i] = NaiveFirstInRegion(module, Signatures[i].pattern, Signatures[i].region);
+        }), true });
+
+        // Single signature engines over the flat image
+        auto detected = Scanner::ActiveEngine;
+        for (auto engine : { Scanner::Engine::Scalar, Scanner::Engine::SSE2, Scanner::Engine::AVX2 }) {
+            if (engine == Scanner::Engine::AVX2 && !Scanner::CpuHasAVX2())
+                continue;
+            Scanner::SetEngine(engine);
+
+            std::vector<std::size_t> results(SignatureCount);
+            auto seconds = Time([&] {
+                for (std::size_t i = 0; i < SignatureCount; ++i)
+                    results[i] = Scanner::FindFirst(module.base, module.sizeOfImage - 1, Signatures[i].pattern);
+            });
+            timings.push_back({ "PatternScan", Scanner::EngineName(engine), seconds, results == firsts });
+
+            std::vector<std::vector<std::size_t>> allResults(SignatureCount);
+            seconds = Time([&] {
+                for (std::size_t i = 0; i < SignatureCount; ++i)
+                    allResults[i] = Scanner::FindAll(module.base, module.sizeOfImage - 1, Signatures[i].pattern);
+            });
+            timings.push_back({ "PatternScanAll", Scanner::EngineName(engine), seconds, allResults == alls });
+
+            Scanner::Batch batch;
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                batch.Add(Signatures[i].pattern);
+            // MultiPatternScan is the first hit of this batch in list order
+            std::size_t multiResult = Scanner::npos;
+            seconds = Time([&] {
+                batch.Run(module.base, module.sizeOfImage - 1);
+                for (std::size_t i = 0; i < SignatureCount && multiResult == Scanner::npos; ++i)
+                    multiResult = batch.First(i);
+            });
+            bool matches = multiResult == multiFirst;
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                matches &= batch.First(i) == firsts[i];
+            timings.push_back({ "MultiPatternScan", std::string("Batch ") + Scanner::EngineName(engine), seconds, matches });
+        }
+        Scanner::SetEngine(detected);
+
+        // Lazy forms: the match range walked to the end, and the uniqueness check that stops at a second match
+        std::vector<std::vector<std::size_t>> lazyResults(SignatureCount);
+        auto seconds = Time([&] {
+            for (std::size_t i = 0; i < SignatureCount; ++i) {
+                for (auto offset : Scanner::Matches(module.base, module.sizeOfImage - 1, Signatures[i].pattern))
+                    lazyResults[i].push_back(offset);
+            }
+        });
+        timings.push_back({ "PatternScanAll", "Match range", seconds, lazyResults == alls });
+
+        std::vector<Scanner::UniqueMatch> unique(SignatureCount);
+        seconds = Time([&] {
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                unique[i] = Scanner::FindUnique(module.base, module.sizeOfImage - 1, Signatures[i].pattern);
+        });
+        bool uniqueMatches = true;
+        for (std::size_t i = 0; i < SignatureCount; ++i)
+            uniqueMatches &= unique[i].offset == firsts[i] && unique[i].ambiguous == (alls[i].size() > 1);
+        timings.push_back({ "PatternScanUnique", Scanner::EngineName(detected), seconds, uniqueMatches });
+
+        // Section aware scans, the first one pays for the rare byte index
+        for (auto pass : { "cold", "warm" }) {
+            std::vector<std::size_t> results(SignatureCount);
+            auto seconds = Time([&] {
+                for (std::size_t i = 0; i < SignatureCount; ++i)
+                    results[i] = PE::PatternScan(module, Signatures[i].pattern, Signatures[i].region);
+            });
+            timings.push_back({ "PatternScan", std::string("Sections ") + pass, seconds, results == regionFirsts });
+        }
+
+        Scanner::Batch batch;
+        for (std::size_t i = 0; i < SignatureCount; ++i)
+            batch.Add(Signatures[i].pattern, false, Signatures[i].region);
+
+        auto checkBatch = [&] {
+            bool matches = true;
+            for (std::size_t i = 0; i < SignatureCount; ++i)
+                matches &= batch.First(i) == regionFirsts[i];
+            return matches;
+        };
+
+        seconds = Time([&] { PE::PatternScanBatch(module, batch); });
+        timings.push_back({ "PatternScanBatch", "Sections", seconds, checkBatch() });
+
+        // Scaling over the pool, doubling up to the thread count. Each pool is warmed up once so
+        // thread startup isn't counted, the fix creates its pool before the first scan.
+        for (std::size_t count = 2; count < threads * 2; count *= 2) {
+            count = std::min(count, threads);
+            Scanner::WorkerPool pool(count);
+            PE::PatternScanBatch(module, batch, &pool);
+            seconds = Time([&] { PE::PatternScanBatch(module, batch, &pool); });
+            timings.push_back({ "PatternScanBatch", "Sections x" + std::to_string(count), seconds, checkBatch() });
+        }
+
+        // Streamed from disk. The odd chunk size puts boundaries through the middle of signatures.
+        auto path = std::filesystem::temp_directory_path() / "scanbench.exe";
+        {
+            auto file = Synthetic::FileLayout(image);
+            std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        }
+
+        auto streamFile = [&](auto& source, const char* name) {
+            auto fileModule = PE::LoadFile(source);
+            for (std::size_t chunkSize : { std::size_t(4099), Scanner::Stream::DefaultChunkSize }) {
+                bool read = false;
+                seconds = Time([&] { read = fileModule && PE::PatternScanBatch(source, *fileModule, batch, chunkSize); });
+
+                // Every hit maps back to the same bytes in the file
+                bool matches = read && checkBatch();
+                for (std::size_t i = 0; matches && i < SignatureCount; ++i) {
+                    auto rva = batch.First(i);
+                    if (rva == Scanner::npos)
+                        continue;
+                    auto offset = PE::RvaToFileOffset(*fileModule, static_cast<std::uint32_t>(rva));
+                    std::vector<std::byte> bytes(Signatures[i].pattern.size());
+                    matches = offset != Scanner::npos && PE::FileOffsetToRva(*fileModule, offset) == rva
+                        && source.Read(offset, bytes) == bytes.size() && Scanner::Verify(reinterpret_cast<const std::uint8_t*>(bytes.data()), Signatures[i].pattern);
+                }
+                timings.push_back({ "PatternScanBatch", std::string(name) + " " + std::to_string(chunkSize), seconds, matches });
+            }
+        };
+
+        PE::FileReader reader;
+        if (reader.Open(path))
+            streamFile(reader, "File read");
+        else
+            timings.push_back({ "PatternScanBatch", "File read", 0, false });
+
+        PE::MappedFile mapped;
+        if (mapped.Open(path))
+            streamFile(mapped, "File map");
+        else
+            timings.push_back({ "PatternScanBatch", "File map", 0, false });
+
+        mapped.Close();
+        reader = {};
+        std::filesystem::remove(path);
+
+        bool ok = true;
+        std::printf("%-18s %-22s %12s %10s  %s\n", "Operation", "Engine", "Total ms", "ns/byte", "Result");
+        for (const auto& timing : timings) {
+            std::printf("%-18s %-22s %12.2f %10.4f  %s\n", timing.operation, timing.engine.c_str(), timing.seconds * 1e3, timing.seconds * 1e9 / bytes, timing.matches ? "ok" : "MISMATCH");
+            ok &= timing.matches;
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::size_t> sizes;
+    std::size_t threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, 8);
+
+    // Sizes are whole megabytes, anything else is a mistake rather than a 0 MB image
+    auto megabytes = [](const std::string& text) -> std::size_t {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+            return 0;
+        return std::strtoul(text.c_str(), nullptr, 10);
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--threads" && i + 1 < argc)
+            threads = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        else if (auto size = megabytes(argument))
+            sizes.push_back(size);
+        else {
+            std::fprintf(stderr, "Usage: scanbench [size in MB ...] [--threads N]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (sizes.empty())
+        sizes = { 16, 64, 256, 512 };
+
+    // Pool rows past the hardware thread count only measure oversubscription
+    std::printf("Detected engine: %s, hardware threads: %u\n", Scanner::EngineName(Scanner::ActiveEngine), std::thread::hardware_concurrency());
+
+    bool ok = true;
+    for (auto size : sizes)
+        ok &= Run(size, threads);
+
+    std::printf("\n%s\n", ok ? "All engines match the naive scanner." : "Engines disagree with the naive scanner.");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
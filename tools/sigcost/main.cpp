@@ -0,0 +1,240 @@
+// Signature cost and uniqueness report.
+// Measures what each of the fix's signatures costs to find in an image and whether it is still
+// unique there, to decide which ones are worth rewriting:
+//
+//   - matches: more than one means the fix takes whichever comes first
+//   - the byte-by-byte loop the fix used to scan with: how many positions get past the first
+//     literal byte, and how many bytes it compares on average before rejecting a position
+//   - candidates per anchor choice: positions a scan anchored on each literal byte has to verify
+//   - the anchor pair the engines pick from static byte ranks, against the cheapest single byte
+//     and the cheapest run of two literal bytes in this image
+//
+//   sigcost <game exe>
+//   sigcost --synthetic MB
+//
+// The synthetic image is the scanbench one with every signature planted once. The report only
+// depends on the image, so the same arguments always print the same numbers.
+
+#include "pefile.hpp"
+#include "signatures.hpp"
+#include "synthetic.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char* RegionName(Scanner::Region region)
+    {
+        switch (region) {
+        case Scanner::Region::Code: return "Code";
+        case Scanner::Region::Data: return "Data";
+        default: return "Any";
+        }
+    }
+
+    struct Range
+    {
+        const std::uint8_t* data;
+        std::size_t size;
+    };
+
+    // The ranges a signature is scanned in: the flat image for Any, every matching section otherwise
+    std::vector<Range> Ranges(const PE::Module& module, Scanner::Region region)
+    {
+        if (region == Scanner::Region::Any)
+            return { { module.base, module.sizeOfImage - 1u } };
+
+        std::vector<Range> ranges;
+        for (const auto& section : module.sections) {
+            if (section.In(region))
+                ranges.push_back({ module.base + section.rva, section.size });
+        }
+        return ranges;
+    }
+
+    // Byte and byte pair frequencies of one region
+    struct Histogram
+    {
+        std::array<std::uint64_t, 256> bytes{};
+        std::vector<std::uint64_t> pairs = std::vector<std::uint64_t>(1 << 16);
+        std::uint64_t size = 0;
+
+        explicit Histogram(const std::vector<Range>& ranges)
+        {
+            for (const auto& range : ranges) {
+                size += range.size;
+                for (std::size_t i = 0; i < range.size; ++i) {
+                    ++bytes[range.data[i]];
+                    if (i + 1 < range.size)
+                        ++pairs[range.data[i] << 8 | range.data[i + 1]];
+                }
+            }
+        }
+    };
+
+    struct Cost
+    {
+        std::uint64_t positions = 0;
+        std::uint64_t partial = 0;      // Positions whose first literal byte matched
+        std::uint64_t compares = 0;     // Literal bytes compared by the naive loop, mismatches included
+        std::uint64_t pairCandidates = 0;
+        std::vector<std::size_t> matches;
+    };
+
+    // Replays the naive loop over every position, and counts the positions the engines'
+    // two-anchor filter lets through to a full verify
+    Cost Measure(const std::vector<Range>& ranges, const Scanner::Pattern& pattern, const std::uint8_t* base)
+    {
+        Cost cost;
+        for (const auto& range : ranges) {
+            if (range.size < pattern.size())
+                continue;
+            auto positions = range.size - pattern.size() + 1;
+            cost.positions += positions;
+
+            for (std::size_t i = 0; i < positions; ++i) {
+                const auto* data = range.data + i;
+                std::uint64_t compared = 0;
+                bool found = true;
+                for (std::size_t j = 0; j < pattern.size(); ++j) {
+                    if (!pattern.mask[j])
+                        continue;
+                    ++compared;
+                    if (data[j] != pattern.bytes[j]) {
+                        found = false;
+                        break;
+                    }
+                }
+                cost.compares += compared;
+                cost.partial += compared > 1 || found;
+                if (found)
+                    cost.matches.push_back(static_cast<std::size_t>(data - base));
+
+                cost.pairCandidates += pattern.hasLiteral && data[pattern.anchor] == pattern.bytes[pattern.anchor] && data[pattern.anchor2] == pattern.bytes[pattern.anchor2];
+            }
+        }
+        return cost;
+    }
+
+    std::string Human(std::uint64_t count)
+    {
+        char buffer[32];
+        if (count >= 1'000'000)
+            std::snprintf(buffer, sizeof(buffer), "%.1fM", static_cast<double>(count) / 1e6);
+        else if (count >= 10'000)
+            std::snprintf(buffer, sizeof(buffer), "%.1fK", static_cast<double>(count) / 1e3);
+        else
+            std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(count));
+        return buffer;
+    }
+
+    void Report(const PE::Module& module)
+    {
+        std::printf("Timestamp %08X, %u bytes mapped, %zu sections\n", module.timestamp, module.sizeOfImage, module.sections.size());
+
+        std::unique_ptr<Histogram> histograms[3];
+        for (std::size_t i = 0; i < SignatureCount; ++i) {
+            const auto& [name, pattern, region, stage, feature] = Signatures[i];
+            auto ranges = Ranges(module, region);
+            auto& histogram = histograms[static_cast<int>(region)];
+            if (!histogram)
+                histogram = std::make_unique<Histogram>(ranges);
+
+            auto cost = Measure(ranges, pattern, module.base);
+            std::printf("\n%s (%s, %zu bytes, %zu literal)\n", name, RegionName(region), pattern.size(),
+                static_cast<std::size_t>(std::count(pattern.mask, pattern.mask + pattern.size(), 0xFF)));
+
+            std::printf("  Matches            %zu%s\n", cost.matches.size(), cost.matches.empty() ? "  MISSING" : cost.matches.size() > 1 ? "  NOT UNIQUE" : "");
+            for (std::size_t m = 0; m < cost.matches.size() && m < 4; ++m)
+                std::printf("                     %zX\n", cost.matches[m]);
+            if (!pattern.hasLiteral || cost.positions == 0)
+                continue;
+
+            std::printf("  Naive loop         %s positions, %s past the first byte, %.3f bytes compared per position\n",
+                Human(cost.positions).c_str(), Human(cost.partial).c_str(), static_cast<double>(cost.compares) / static_cast<double>(cost.positions));
+
+            // Candidates for every literal byte, the cheapest single byte and the cheapest pair
+            std::string perAnchor;
+            std::size_t bestByte = Scanner::npos, bestPair = Scanner::npos;
+            for (std::size_t j = 0; j < pattern.size(); ++j) {
+                if (!pattern.mask[j])
+                    continue;
+                char entry[48];
+                std::snprintf(entry, sizeof(entry), " +%zX:%02X=%s", j, pattern.bytes[j], Human(histogram->bytes[pattern.bytes[j]]).c_str());
+                perAnchor += entry;
+
+                if (bestByte == Scanner::npos || histogram->bytes[pattern.bytes[j]] < histogram->bytes[pattern.bytes[bestByte]])
+                    bestByte = j;
+                auto pair = [&](std::size_t at) { return histogram->pairs[pattern.bytes[at] << 8 | pattern.bytes[at + 1]]; };
+                if (j + 1 < pattern.size() && pattern.mask[j + 1] && (bestPair == Scanner::npos || pair(j) < pair(bestPair)))
+                    bestPair = j;
+            }
+            std::printf("  Anchor candidates %s\n", perAnchor.c_str());
+
+            auto engine = histogram->bytes[pattern.bytes[pattern.anchor]];
+            std::printf("  Engine anchors     +%zX:%02X and +%zX:%02X, %s candidates on the first, %s on both\n", pattern.anchor, pattern.bytes[pattern.anchor],
+                pattern.anchor2, pattern.bytes[pattern.anchor2], Human(engine).c_str(), Human(cost.pairCandidates).c_str());
+
+            auto byteCost = histogram->bytes[pattern.bytes[bestByte]];
+            std::printf("  Cheapest byte      +%zX:%02X, %s candidates\n", bestByte, pattern.bytes[bestByte], Human(byteCost).c_str());
+            if (bestPair != Scanner::npos) {
+                auto pairCost = histogram->pairs[pattern.bytes[bestPair] << 8 | pattern.bytes[bestPair + 1]];
+                std::printf("  Cheapest run       +%zX:%02X %02X, %s candidates\n", bestPair, pattern.bytes[bestPair], pattern.bytes[bestPair + 1], Human(pairCost).c_str());
+            }
+            else {
+                std::printf("  Cheapest run       none, no two literal bytes are adjacent\n");
+            }
+
+            // Worth acting on when this image disagrees with the static ranks by a wide margin
+            if (byteCost * 4 < engine)
+                std::printf("  Suggestion         anchor on +%zX, %.1fx fewer candidates than the engine's pick\n", bestByte, static_cast<double>(engine) / static_cast<double>(std::max<std::uint64_t>(byteCost, 1)));
+            if (cost.matches.size() > 1)
+                std::printf("  Suggestion         extend the signature with the bytes around the intended match\n");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path input;
+    std::size_t synthetic = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--synthetic" && i + 1 < argc)
+            synthetic = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+        else
+            input = argument;
+    }
+
+    if (synthetic) {
+        auto image = Synthetic::Make(synthetic << 20);
+        std::mt19937 rng(7);
+        for (std::size_t i = 0; i < SignatureCount; ++i) {
+            auto at = Signatures[i].region == Scanner::Region::Data ? image.rdataRva + image.rdataSize / 2 : image.textRva + image.textSize / 2;
+            Synthetic::Plant(image.bytes.data() + at + i * 0x100, Signatures[i].pattern, rng);
+        }
+        Report(PE::Load(image.bytes.data()));
+        return EXIT_SUCCESS;
+    }
+
+    if (input.empty()) {
+        std::fprintf(stderr, "Usage: sigcost <game exe> | --synthetic MB\n");
+        return EXIT_FAILURE;
+    }
+
+    PE::MappedFile file;
+    auto module = file.Open(input) ? PE::LoadFile(file) : std::nullopt;
+    auto image = module ? PE::ReadImage(file, *module) : std::nullopt;
+    if (!image) {
+        std::fprintf(stderr, "Failed to read %s as a PE image.\n", input.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    Report(PE::Load(image->data()));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "scanner.hpp"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+// PE-shaped images for exercising the scanner outside the game: real headers, a .text section
+// filled with instruction-shaped bytes, and .rdata/.data sections filled with strings, floats,
+// pointers and padding. Byte frequencies land close to a real x86-64 executable.
+namespace Synthetic
+{
+    struct Image
+    {
+        std::vector<std::uint8_t> bytes;
+        std::uint32_t textRva = 0;
+        std::uint32_t textSize = 0;
+        std::uint32_t rdataRva = 0;
+        std::uint32_t rdataSize = 0;
+        std::uint32_t dataRva = 0;
+        std::uint32_t dataSize = 0;
+    };
+
+    inline constexpr std::uint32_t HeaderSize = 0x1000;
+    inline constexpr std::uint32_t FileHeaderSize = 0x400;  // SizeOfHeaders, the first FileAlignment block
+    inline constexpr std::uint32_t Timestamp = 0x65A1B2C3;
+
+    template<typename T>
+    void Put(std::uint8_t* address, T value)
+    {
+        std::memcpy(address, &value, sizeof(T));
+    }
+
+    // Appends one instruction-like sequence
+    inline std::size_t EmitInstruction(std::uint8_t* out, std::mt19937& rng)
+    {
+        auto modrm = [&] { return static_cast<std::uint8_t>(rng() & 0xFF); };
+        auto disp8 = [&] { return static_cast<std::uint8_t>((rng() % 16) * 8); };
+
+        switch (rng() % 20) {
+        case 0: case 1: case 2:     // mov r64, [r64 + disp8]
+            out[0] = 0x48; out[1] = 0x8B; out[2] = 0x40 | (modrm() & 0x3F); out[3] = disp8();
+            return 4;
+        case 3: case 4:             // mov [rsp + disp8], r32
+            out[0] = 0x89; out[1] = 0x44; out[2] = 0x24; out[3] = disp8();
+            return 4;
+        case 5: case 6:             // call rel32
+            out[0] = 0xE8;
+            Put(out + 1, static_cast<std::int32_t>(rng() % 0x400000) - 0x200000);
+            return 5;
+        case 7:                     // movss xmm, [r64 + disp8]
+            out[0] = 0xF3; out[1] = 0x0F; out[2] = 0x10 | (rng() & 1); out[3] = 0x40 | (modrm() & 0x3F); out[4] = disp8();
+            return 5;
+        case 8:                     // mulss/addss xmm, xmm
+            out[0] = 0xF3; out[1] = 0x0F; out[2] = (rng() & 1) ? 0x59 : 0x58; out[3] = 0xC0 | (modrm() & 0x3F);
+            return 4;
+        case 9:                     // sub/add rsp, imm8
+            out[0] = 0x48; out[1] = 0x83; out[2] = (rng() & 1) ? 0xEC : 0xC4; out[3] = disp8();
+            return 4;
+        case 10:                    // test/cmp, jcc rel8
+            out[0] = 0x48; out[1] = 0x85; out[2] = 0xC0 | (modrm() & 0x3F); out[3] = (rng() & 1) ? 0x74 : 0x75; out[4] = static_cast<std::uint8_t>(rng() % 0x40);
+            return 5;
+        case 11:                    // REX.B mov
+            out[0] = 0x41; out[1] = 0x8B; out[2] = modrm() & 0x3F;
+            return 3;
+        case 12:                    // lea r64, [rip + disp32]
+            out[0] = 0x48; out[1] = 0x8D; out[2] = 0x05 | ((rng() % 8) << 3);
+            Put(out + 3, static_cast<std::int32_t>(rng() % 0x1000000));
+            return 7;
+        case 13:                    // xor r32, r32
+            out[0] = 0x33; out[1] = 0xC0 | (modrm() & 0x3F);
+            return 2;
+        case 14:                    // movaps [rsp + disp8], xmm
+            out[0] = 0x0F; out[1] = 0x29; out[2] = 0x74; out[3] = 0x24; out[4] = disp8();
+            return 5;
+        case 15:                    // push/pop
+            out[0] = static_cast<std::uint8_t>(0x50 + (rng() % 16));
+            return 1;
+        case 16:                    // mov r32, imm32
+            out[0] = 0xB8 + (rng() % 8);
+            Put(out + 1, static_cast<std::uint32_t>(rng() % 0x10000));
+            return 5;
+        case 17:                    // ret and int3 padding to 16 bytes
+        {
+            out[0] = 0xC3;
+            std::size_t length = 1 + rng() % 15;
+            std::memset(out + 1, 0xCC, length - 1);
+            return length;
+        }
+        case 18:                    // jmp rel8
+            out[0] = 0xEB; out[1] = static_cast<std::uint8_t>(rng() % 0x80);
+            return 2;
+        default:                    // Anything else
+            for (int i = 0; i < 3; ++i)
+                out[i] = static_cast<std::uint8_t>(rng());
+            return 3;
+        }
+    }
+
+    inline void FillCode(std::uint8_t* data, std::size_t size, std::mt19937& rng)
+    {
+        std::uint8_t instruction[32];
+        for (std::size_t i = 0; i < size;) {
+            auto length = std::min(EmitInstruction(instruction, rng), size - i);
+            std::memcpy(data + i, instruction, length);
+            i += length;
+        }
+    }
+
+    inline void FillData(std::uint8_t* data, std::size_t size, std::mt19937& rng)
+    {
+        static constexpr char Words[] = "capture_plane_full_rgba8 PIC_common_square_bl WIN_base_system_bg letterbox config.ini ";
+        for (std::size_t i = 0; i + 16 <= size; i += 16) {
+            switch (rng() % 6) {
+            case 0: case 1:         // Zero padding
+                break;
+            case 2:                 // Text
+                std::memcpy(data + i, Words + rng() % (sizeof(Words) - 17), 15);
+                break;
+            case 3:                 // Floats
+                for (int j = 0; j < 4; ++j)
+                    Put(data + i + j * 4, static_cast<float>(rng() % 4096) / 4.00f);
+                break;
+            case 4:                 // Pointers into the image
+                Put(data + i, std::uint64_t(0x140000000) + rng() % 0x4000000);
+                Put(data + i + 8, std::uint64_t(0x140000000) + rng() % 0x4000000);
+                break;
+            default:                // Small integers
+                for (int j = 0; j < 4; ++j)
+                    Put(data + i + j * 4, static_cast<std::uint32_t>(rng() % 256));
+                break;
+            }
+        }
+    }
+
+    // Writes a concrete instance of pattern at data, wildcards filled with random bytes
+    inline void Plant(std::uint8_t* data, const Scanner::Pattern& pattern, std::mt19937& rng)
+    {
+        for (std::size_t i = 0; i < pattern.size(); ++i)
+            data[i] = pattern.mask[i] ? pattern.bytes[i] : static_cast<std::uint8_t>(rng());
+    }
+
+    // size is rounded to a multiple of the page size. Sections are 60% .text, 25% .rdata, 15% .data.
+    inline Image Make(std::size_t size, unsigned seed = 1)
+    {
+        size = (std::max<std::size_t>(size, 0x10000) + 0xFFF) & ~std::size_t(0xFFF);
+
+        Image image;
+        image.bytes.assign(size, 0);
+        auto body = size - HeaderSize;
+        image.textRva = HeaderSize;
+        image.textSize = static_cast<std::uint32_t>((body * 60 / 100) & ~std::size_t(0xFFF));
+        image.rdataRva = image.textRva + image.textSize;
+        image.rdataSize = static_cast<std::uint32_t>((body * 25 / 100) & ~std::size_t(0xFFF));
+        image.dataRva = image.rdataRva + image.rdataSize;
+        image.dataSize = static_cast<std::uint32_t>(size - image.dataRva);
+
+        std::mt19937 rng(seed);
+        auto base = image.bytes.data();
+        FillCode(base + image.textRva, image.textSize, rng);
+        FillData(base + image.rdataRva, image.rdataSize, rng);
+        FillData(base + image.dataRva, image.dataSize, rng);
+
+        // Headers
+        base[0] = 'M';
+        base[1] = 'Z';
+        Put<std::int32_t>(base + 0x3C, 0x80);
+        auto nt = base + 0x80;
+        std::memcpy(nt, "PE\0\0", 4);
+        auto fileHeader = nt + 0x4;
+        Put<std::uint16_t>(fileHeader, 0x8664);
+        Put<std::uint16_t>(fileHeader + 0x2, 3);
+        Put<std::uint32_t>(fileHeader + 0x4, Timestamp);
+        Put<std::uint16_t>(fileHeader + 0x10, 0xF0);
+        auto optionalHeader = fileHeader + 0x14;
+        Put<std::uint16_t>(optionalHeader, 0x20B);
+        Put<std::uint32_t>(optionalHeader + 0x38, static_cast<std::uint32_t>(size));
+        Put<std::uint32_t>(optionalHeader + 0x3C, FileHeaderSize);
+
+        auto section = optionalHeader + 0xF0;
+        auto addSection = [&](const char* name, std::uint32_t rva, std::uint32_t length, std::uint32_t characteristics) {
+            std::memcpy(section, name, std::strlen(name));
+            Put(section + 0x8, length);
+            Put(section + 0xC, rva);
+            Put(section + 0x10, length);
+            Put(section + 0x14, rva);
+            Put(section + 0x24, characteristics);
+            section += 0x28;
+        };
+        addSection(".text", image.textRva, image.textSize, 0x60000020);
+        addSection(".rdata", image.rdataRva, image.rdataSize, 0x40000040);
+        addSection(".data", image.dataRva, image.dataSize, 0xC0000040);
+
+        return image;
+    }
+
+    // The image as it would sit on disk: headers in the first FileHeaderSize bytes and each
+    // section's raw data packed behind them, so file offsets and rvas differ
+    inline std::vector<std::uint8_t> FileLayout(const Image& image)
+    {
+        std::vector<std::uint8_t> file(FileHeaderSize + image.textSize + image.rdataSize + image.dataSize);
+        std::memcpy(file.data(), image.bytes.data(), FileHeaderSize);
+
+        auto section = file.data() + 0x80 + 0x18 + 0xF0;
+        std::uint32_t rawOffset = FileHeaderSize;
+        for (auto [rva, size] : { std::pair{ image.textRva, image.textSize }, { image.rdataRva, image.rdataSize }, { image.dataRva, image.dataSize } }) {
+            std::memcpy(file.data() + rawOffset, image.bytes.data() + rva, size);
+            Put(section + 0x14, rawOffset);
+            rawOffset += size;
+            section += 0x28;
+        }
+        return file;
+    }
+}
@@ -3,6 +3,20 @@ add_rules("mode.debug", "mode.release")
 set_languages("cxxlatest", "clatest")
 set_optimize("faster")
 
+option("alloc_tracking")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Count heap allocations made inside hook bodies")
+    add_defines("HOOK_ALLOC_TRACKING")
+option_end()
+
+option("profiling")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Record per-hook call counts and latency histograms")
+    add_defines("HOOK_PROFILING")
+option_end()
+
   target("FateSamuraiRemnantFix")
     set_kind("shared")
     add_files("src/**.cpp", "external/safetyhook/safetyhook.cpp", "external/safetyhook/Zydis.c")
@@ -10,6 +24,7 @@ set_optimize("faster")
     add_includedirs("external/spdlog/include", "external/inipp", "external/safetyhook")
     set_prefixname("")
     set_extension(".asi")
+    add_options("alloc_tracking", "profiling")
 
   -- Set platform specific toolchain
   if is_plat("windows") then
@@ -21,3 +36,32 @@ set_optimize("faster")
       add_cxflags("/MTd")
     end
   end
+
+-- Native tools, not part of the fix itself
+if is_plat("linux") then
+  target("scanbench")
+    set_kind("binary")
+    set_default(false)
+    add_files("tools/scanbench/main.cpp")
+    add_includedirs("src", "tools")
+    add_syslinks("pthread")
+
+  target("hookbench")
+    set_kind("binary")
+    set_default(false)
+    add_files("tools/hookbench/main.cpp")
+    add_includedirs("src", "tools", "external/spdlog/include")
+    add_syslinks("pthread")
+
+  target("offsettable")
+    set_kind("binary")
+    set_default(false)
+    add_files("tools/offsettable/main.cpp")
+    add_includedirs("src")
+
+  target("sigcost")
+    set_kind("binary")
+    set_default(false)
+    add_files("tools/sigcost/main.cpp")
+    add_includedirs("src", "tools")
+end